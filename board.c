@@ -0,0 +1,1050 @@
+/*
+ * packed minesweeper board (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* the preset kernels are only fast once the board size is a constant */
+#if defined(__GNUC__)
+#define PRESET_INLINE __attribute__((always_inline))
+#else
+#define PRESET_INLINE
+#endif
+#define PRESET_WORDS(w, h) ((((w) + 2) * ((h) + 2) + 63) / 64)
+#define PRESET_MAXWORDS PRESET_WORDS(30, 16)
+
+struct board_preset
+{
+	int width;
+	int height;
+	void (*countneighbors)(struct board *board);
+	size_t (*reveal)(struct board *board, size_t i);
+};
+
+static uint64_t lastmask(const struct board *board);
+static void setrange(uint64_t *plane, size_t start, size_t n);
+static uint64_t getbits(const uint64_t *plane, size_t words, size_t i);
+static void expandrow(const struct board *board, int y, uint8_t *row);
+static void sumrow(const uint8_t *up, const uint8_t *mid, const uint8_t *down, uint8_t *out, int width);
+static void packrow(struct board *board, int y, const uint8_t *out);
+static void countneighbors_tile(struct board *board);
+static void countneighbors_rows(struct board *board);
+static void markchanged(struct board *board, size_t i);
+static int pushseed(struct board *board, size_t i);
+static size_t openborder(struct board *board, size_t from, size_t to);
+static size_t floodreveal(struct board *board, size_t i);
+static inline uint64_t shiftword(const uint64_t *plane, int words, int k, int shift);
+static inline void dilate(const uint64_t *in, uint64_t *out, int words, int stride);
+static inline uint64_t spreadnibbles(uint64_t bits);
+static inline void presetcount(struct board *board, int words, int stride);
+static inline size_t presetreveal(struct board *board, size_t i, int words, int stride);
+static const struct board_preset *findpreset(int width, int height);
+static void freeregions(struct board *board);
+static void regionpass(struct board *board, const size_t *rowfirst, size_t *lastend, size_t *next, int fill);
+static size_t openspan(struct board *board, size_t start, size_t length);
+static size_t regionreveal(struct board *board, size_t i);
+static size_t fastreveal(struct board *board, size_t i);
+#ifdef BOARD_DEBUG
+static size_t checkedreveal(struct board *board, size_t i);
+#endif
+
+static uint64_t
+lastmask(const struct board *board)
+{
+	/* bits of the final word that are part of the board */
+	int used = board->bits & 63;
+	return used ? ((uint64_t)1 << used) - 1 : ~(uint64_t)0;
+}
+
+static void
+setrange(uint64_t *plane, size_t start, size_t n)
+{
+	size_t end = start + n;
+	for (; start < end && (start & 63); start++)
+		BOARD_SET(plane, start);
+	for (; start + 64 <= end; start += 64)
+		plane[start >> 6] = ~(uint64_t)0;
+	for (; start < end; start++)
+		BOARD_SET(plane, start);
+}
+
+int
+board_init(struct board *board, int width, int height)
+{
+	memset(board, 0, sizeof *board);
+	/* the sentinel border must fit in an int and every bit index in a size_t */
+	if (width <= 0 || height <= 0 || width > INT_MAX - 2 || height > INT_MAX - 2)
+		return 0;
+	if ((size_t)width + 2 > (SIZE_MAX - 63) / ((size_t)height + 2))
+		return 0;
+	board->width = width;
+	board->height = height;
+	board->tiles = (size_t)width * height;
+	/* one sentinel column either side and a sentinel row above and below */
+	board->stride = width + 2;
+	board->origin = board->stride + 1;
+	board->bits = (size_t)board->stride * (height + 2);
+	board->words = (board->bits + 63) / 64;
+	board->mine = calloc(board->words, sizeof(uint64_t));
+	board->hidden = calloc(board->words, sizeof(uint64_t));
+	board->flagged = calloc(board->words, sizeof(uint64_t));
+	board->counts = calloc((board->bits + 1) / 2, 1);
+	board->preset = findpreset(width, height);
+	if (board->preset)
+		board->zero = calloc(board->words, sizeof(uint64_t));
+	if (!board->mine || !board->hidden || !board->flagged || !board->counts ||
+			(board->preset && !board->zero))
+	{
+		board_free(board);
+		return 0;
+	}
+	/* the flood fill stack is kept between reveals and only ever grows */
+	board->seedcap = 64;
+	board->seeds = malloc(board->seedcap * sizeof(size_t));
+	if (!board->seeds)
+		board->seedcap = 0;
+	/*
+	 * every real tile starts hidden. sentinels are never hidden, mined or
+	 * counted, so neighbor walks and the flood fill stop on them without
+	 * any range checks
+	 */
+	for (int y = 0; y < height; y++)
+		setrange(board->hidden, board_index(board, 0, y), width);
+	return 1;
+}
+
+void
+board_free(struct board *board)
+{
+	free(board->mine);
+	free(board->hidden);
+	free(board->flagged);
+	free(board->counts);
+	free(board->zero);
+	free(board->seeds);
+	free(board->changes);
+	freeregions(board);
+	memset(board, 0, sizeof *board);
+}
+
+void
+board_reset(struct board *board)
+{
+	/* back to the start of a game on the same mines */
+	memset(board->hidden, 0, board->words * sizeof(uint64_t));
+	memset(board->flagged, 0, board->words * sizeof(uint64_t));
+	for (int y = 0; y < board->height; y++)
+		setrange(board->hidden, board_index(board, 0, y), board->width);
+	board->revealed = 0;
+	board->correctflags = 0;
+	board->changesdropped = 1;
+}
+
+void
+board_sethidden(struct board *board, int x, int y, int hidden)
+{
+	/* set a tile directly without flooding, for restoring saved states */
+	size_t i = board_index(board, x, y);
+	if (BOARD_TEST(board->hidden, i) == (uint64_t)!!hidden)
+		return;
+	if (hidden)
+		BOARD_SET(board->hidden, i);
+	else
+		BOARD_CLEAR(board->hidden, i);
+	if (!BOARD_TEST(board->mine, i))
+		board->revealed += hidden ? -1 : 1;
+	markchanged(board, i);
+}
+
+void
+board_setmine(struct board *board, int x, int y)
+{
+	size_t i = board_index(board, x, y);
+	if (BOARD_TEST(board->mine, i))
+		return;
+	BOARD_SET(board->mine, i);
+	board->minecount++;
+	if (BOARD_TEST(board->flagged, i))
+		board->correctflags++;
+}
+
+void
+board_placemines(struct board *board, int count, struct rng *rng)
+{
+	/*
+	 * floyd's sampling, each step draws once and either takes the drawn tile
+	 * or, if it is already a mine, the newest candidate tile j. that is
+	 * exactly count draws with no retries at any density
+	 */
+	if (count < 0)
+		count = 0;
+	if ((size_t)count > board->tiles)
+		count = board->tiles;
+	for (size_t j = board->tiles - count; j < board->tiles; j++)
+	{
+		size_t t = rng_below(rng, j + 1);
+		if (board_state(board, t % board->width, t / board->width) & MINE)
+			t = j;
+		board_setmine(board, t % board->width, t / board->width);
+	}
+}
+
+void
+board_toggleflag(struct board *board, int x, int y)
+{
+	size_t i = board_index(board, x, y);
+	board->flagged[i >> 6] ^= (uint64_t)1 << (i & 63);
+	markchanged(board, i);
+	if (BOARD_TEST(board->mine, i))
+		board->correctflags += BOARD_TEST(board->flagged, i) ? 1 : -1;
+}
+
+static uint64_t
+getbits(const uint64_t *plane, size_t words, size_t i)
+{
+	/* 64 bits of a plane starting at any bit index */
+	size_t w = i >> 6;
+	int off = i & 63;
+	uint64_t bits = plane[w] >> off;
+	if (off && w+1 < words)
+		bits |= plane[w+1] << (64 - off);
+	return bits;
+}
+
+static void
+expandrow(const struct board *board, int y, uint8_t *row)
+{
+	/* one byte per mine bit with a zero column either side of the row */
+	if (y < 0 || y >= board->height)
+	{
+		memset(row, 0, board->width+2);
+		return;
+	}
+	size_t base = board_index(board, 0, y);
+	row[0] = 0;
+	row[board->width+1] = 0;
+	for (int x = 0; x < board->width; x += 64)
+	{
+		uint64_t bits = getbits(board->mine, board->words, base + x);
+		int n = board->width - x < 64 ? board->width - x : 64;
+		int k = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		/* spread 8 bits into the top bit of 8 bytes, then shift them down */
+		for (; k + 8 <= n; k += 8)
+		{
+			uint64_t bytes = ((bits >> k) & 0xff) * 0x0101010101010101ULL;
+			bytes &= 0x8040201008040201ULL;
+			bytes = ((bytes + 0x7f7f7f7f7f7f7f7fULL) >> 7) & 0x0101010101010101ULL;
+			memcpy(row + 1 + x + k, &bytes, 8);
+		}
+#endif
+		for (; k < n; k++)
+			row[1+x+k] = (bits >> k) & 1;
+	}
+}
+
+static void
+sumrow(const uint8_t *up, const uint8_t *mid, const uint8_t *down, uint8_t *out, int width)
+{
+	/* out[x] is the 3x3 box around mid[x+1] without the centre */
+	int x = 0;
+#if defined(__AVX2__)
+	for (; x + 32 <= width; x += 32)
+	{
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(up + x));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(up + x + 1)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(up + x + 2)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(mid + x)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(mid + x + 2)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(down + x)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(down + x + 1)));
+		sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i *)(down + x + 2)));
+		_mm256_storeu_si256((__m256i *)(out + x), sum);
+	}
+#endif
+#if defined(__SSE2__)
+	for (; x + 16 <= width; x += 16)
+	{
+		__m128i sum = _mm_loadu_si128((const __m128i *)(up + x));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(up + x + 1)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(up + x + 2)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(mid + x)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(mid + x + 2)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(down + x)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(down + x + 1)));
+		sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i *)(down + x + 2)));
+		_mm_storeu_si128((__m128i *)(out + x), sum);
+	}
+#endif
+	for (; x < width; x++)
+	{
+		out[x] = up[x] + up[x+1] + up[x+2] + mid[x] + mid[x+2] +
+			down[x] + down[x+1] + down[x+2];
+	}
+}
+
+static void
+packrow(struct board *board, int y, const uint8_t *out)
+{
+	/* rows of odd width start on the high nibble every other row */
+	size_t i = board_index(board, 0, y);
+	uint8_t *counts = board->counts;
+	int x = 0;
+	if (i & 1)
+	{
+		counts[i >> 1] = (counts[i >> 1] & 0x0f) | (out[0] << 4);
+		x++;
+		i++;
+	}
+	for (; x + 1 < board->width; x += 2, i += 2)
+		counts[i >> 1] = out[x] | (out[x+1] << 4);
+	if (x < board->width)
+		counts[i >> 1] = (counts[i >> 1] & 0xf0) | out[x];
+}
+
+static void
+countneighbors_tile(struct board *board)
+{
+	size_t neighbors[8];
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t i = board_index(board, x, y);
+			int count = 0;
+			board_neighbors(board, i, neighbors);
+			for (int nc = 0; nc < 8; nc++)
+				count += BOARD_TEST(board->mine, neighbors[nc]);
+			board->counts[i >> 1] &= (i & 1) ? 0x0f : 0xf0;
+			board->counts[i >> 1] |= count << ((i & 1) << 2);
+		}
+	}
+}
+
+static void
+countneighbors_rows(struct board *board)
+{
+	/*
+	 * expand three mine rows to one byte per tile and add the eight shifted
+	 * copies 16 or 32 tiles at a time, each row is only expanded once
+	 */
+	size_t rowsize = board->width + 2;
+	uint8_t *buf = malloc(rowsize * 4);
+	if (!buf)
+	{
+		countneighbors_tile(board);
+		return;
+	}
+	uint8_t *up = buf, *mid = buf + rowsize, *down = buf + rowsize*2;
+	uint8_t *out = buf + rowsize*3;
+	expandrow(board, -1, up);
+	expandrow(board, 0, mid);
+	for (int y = 0; y < board->height; y++)
+	{
+		uint8_t *next = up;
+		expandrow(board, y+1, down);
+		sumrow(up, mid, down, out, board->width);
+		packrow(board, y, out);
+		up = mid;
+		mid = down;
+		down = next;
+	}
+	free(buf);
+}
+
+void
+board_countneighbors(struct board *board)
+{
+	/* new counts make any labelled regions stale */
+	freeregions(board);
+	if (board->preset)
+		board->preset->countneighbors(board);
+	else
+		countneighbors_rows(board);
+
+#ifdef BOARD_DEBUG
+	/* the kernel must agree with the per-tile neighbor walk */
+	size_t bytes = (board->bits + 1) / 2;
+	uint8_t *kernel = malloc(bytes);
+	if (kernel)
+	{
+		memcpy(kernel, board->counts, bytes);
+		countneighbors_tile(board);
+		assert(memcmp(kernel, board->counts, bytes) == 0);
+		free(kernel);
+	}
+#endif
+}
+
+static void
+markchanged(struct board *board, size_t i)
+{
+	if (!board->tracking || board->changesdropped)
+		return;
+	if (board->changecount == board->changecap)
+	{
+		size_t cap = board->changecap ? board->changecap * 2 : 256;
+		size_t *changes = realloc(board->changes, cap * sizeof(size_t));
+		if (!changes)
+		{
+			/* the caller has to assume everything changed */
+			board->changesdropped = 1;
+			return;
+		}
+		board->changes = changes;
+		board->changecap = cap;
+	}
+	board->changes[board->changecount++] = i;
+}
+
+void
+board_trackchanges(struct board *board, int enable)
+{
+	board->tracking = enable;
+	board_clearchanges(board);
+}
+
+void
+board_clearchanges(struct board *board)
+{
+	board->changecount = 0;
+	board->changesdropped = 0;
+}
+
+static int
+pushseed(struct board *board, size_t i)
+{
+	if (board->seedcount == board->seedcap)
+	{
+		size_t cap = board->seedcap ? board->seedcap * 2 : 64;
+		size_t *seeds = realloc(board->seeds, cap * sizeof(size_t));
+		if (!seeds)
+			return 0;
+		board->seeds = seeds;
+		board->seedcap = cap;
+	}
+	board->seeds[board->seedcount++] = i;
+	return 1;
+}
+
+static size_t
+openborder(struct board *board, size_t from, size_t to)
+{
+	/*
+	 * open the non-zero tiles between from and to and leave a seed at the
+	 * start of each run of hidden zero tiles, the run itself is opened when
+	 * its seed is popped
+	 */
+	size_t opened = 0;
+	int inrun = 0;
+	for (size_t i = from; i <= to; i++)
+	{
+		if (!BOARD_TEST(board->hidden, i) || BOARD_TEST(board->mine, i))
+		{
+			inrun = 0;
+			continue;
+		}
+		if (board_countat(board, i) == 0)
+		{
+			if (!inrun && !pushseed(board, i))
+				return opened;
+			inrun = 1;
+			continue;
+		}
+		BOARD_CLEAR(board->hidden, i);
+		markchanged(board, i);
+		opened++;
+		inrun = 0;
+	}
+	return opened;
+}
+
+static size_t
+floodreveal(struct board *board, size_t i)
+{
+	/*
+	 * scanline flood fill over the connected zero tiles and their border,
+	 * the sentinel border is never hidden so runs stop at the board edge
+	 */
+	size_t count = 0;
+	size_t stride = board->stride;
+	board->seedcount = 0;
+	pushseed(board, i);
+	while (board->seedcount)
+	{
+		size_t seed = board->seeds[--board->seedcount];
+		size_t first = seed, last = seed;
+		if (!BOARD_TEST(board->hidden, seed))
+			continue;
+		while (BOARD_TEST(board->hidden, first-1) && !BOARD_TEST(board->mine, first-1) &&
+				board_countat(board, first-1) == 0)
+			first--;
+		while (BOARD_TEST(board->hidden, last+1) && !BOARD_TEST(board->mine, last+1) &&
+				board_countat(board, last+1) == 0)
+			last++;
+		for (size_t run = first; run <= last; run++)
+		{
+			BOARD_CLEAR(board->hidden, run);
+			markchanged(board, run);
+		}
+		count += last - first + 1;
+		count += openborder(board, first-1, first-1);
+		count += openborder(board, last+1, last+1);
+		count += openborder(board, first-1 - stride, last+1 - stride);
+		count += openborder(board, first-1 + stride, last+1 + stride);
+	}
+	return count;
+}
+
+static inline PRESET_INLINE uint64_t
+shiftword(const uint64_t *plane, int words, int k, int shift)
+{
+	/* word k of the plane moved so bit i holds tile i+shift, 0 < |shift| < 64 */
+	if (shift > 0)
+		return (plane[k] >> shift) | (k + 1 < words ? plane[k+1] << (64 - shift) : 0);
+	return (plane[k] << -shift) | (k > 0 ? plane[k-1] >> (64 + shift) : 0);
+}
+
+static inline PRESET_INLINE void
+dilate(const uint64_t *in, uint64_t *out, int words, int stride)
+{
+	/* every tile next to or on a tile in the plane, across then down */
+	uint64_t across[PRESET_MAXWORDS];
+	for (int k = 0; k < words; k++)
+		across[k] = in[k] | shiftword(in, words, k, 1) | shiftword(in, words, k, -1);
+	for (int k = 0; k < words; k++)
+		out[k] = across[k] | shiftword(across, words, k, stride) | shiftword(across, words, k, -stride);
+}
+
+static inline uint64_t
+spreadnibbles(uint64_t bits)
+{
+	/* the low 16 bits moved to the low bit of each nibble */
+	bits &= 0xffff;
+	bits = (bits | bits << 24) & 0x000000ff000000ffULL;
+	bits = (bits | bits << 12) & 0x000f000f000f000fULL;
+	bits = (bits | bits << 6) & 0x0303030303030303ULL;
+	bits = (bits | bits << 3) & 0x1111111111111111ULL;
+	return bits;
+}
+
+static inline PRESET_INLINE void
+presetcount(struct board *board, int words, int stride)
+{
+	/*
+	 * add the eight shifted mine planes with a bitsliced counter, bit n of
+	 * every tile's count is in sum[n], then interleave the four planes into
+	 * nibbles sixteen tiles at a time. sentinels get counts too but they
+	 * are never hidden, so neither their count nor their zero bit is read
+	 */
+	const int offsets[8] = { -stride-1, -stride, -stride+1, -1, 1, stride-1, stride, stride+1 };
+	uint64_t sum[4][PRESET_MAXWORDS];
+	size_t bytes = (board->bits + 1) / 2;
+	for (int k = 0; k < words; k++)
+	{
+		uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		for (int n = 0; n < 8; n++)
+		{
+			uint64_t carry0, carry1, add = shiftword(board->mine, words, k, offsets[n]);
+			carry0 = s0 & add;
+			s0 ^= add;
+			carry1 = s1 & carry0;
+			s1 ^= carry0;
+			s3 |= s2 & carry1;
+			s2 ^= carry1;
+		}
+		sum[0][k] = s0;
+		sum[1][k] = s1;
+		sum[2][k] = s2;
+		sum[3][k] = s3;
+		board->zero[k] = ~(s0 | s1 | s2 | s3 | board->mine[k]);
+	}
+	for (size_t at = 0; at < bytes; at += 8)
+	{
+		/* eight bytes of counts are sixteen tiles starting at tile at*2 */
+		size_t k = at >> 5;
+		int shift = (at << 1) & 63;
+		uint64_t nibbles = spreadnibbles(sum[0][k] >> shift) |
+			spreadnibbles(sum[1][k] >> shift) << 1 |
+			spreadnibbles(sum[2][k] >> shift) << 2 |
+			spreadnibbles(sum[3][k] >> shift) << 3;
+		for (size_t b = 0; b < 8 && at + b < bytes; b++)
+			board->counts[at + b] = nibbles >> (b << 3);
+	}
+}
+
+static inline PRESET_INLINE size_t
+presetreveal(struct board *board, size_t i, int words, int stride)
+{
+	/*
+	 * grow the zero region holding i by one ring of tiles a step, each step
+	 * the same shifts and masks over the whole board with no per-tile
+	 * branches. one more ring past the region is its numbered border
+	 */
+	uint64_t region[PRESET_MAXWORDS], grown[PRESET_MAXWORDS];
+	uint64_t changed = 1;
+	size_t opened = 0;
+	memset(region, 0, sizeof region);
+	BOARD_SET(region, i);
+	while (changed)
+	{
+		dilate(region, grown, words, stride);
+		changed = 0;
+		for (int k = 0; k < words; k++)
+		{
+			uint64_t next = grown[k] & board->zero[k] & board->hidden[k];
+			changed |= next ^ region[k];
+			region[k] = next;
+		}
+	}
+	dilate(region, grown, words, stride);
+	for (int k = 0; k < words; k++)
+	{
+		uint64_t bits = grown[k] & board->hidden[k];
+		board->hidden[k] &= ~bits;
+		opened += board_popcount64(bits);
+		if (board->tracking)
+		{
+			for (; bits; bits &= bits - 1)
+				markchanged(board, ((size_t)k << 6) + board_ctz64(bits));
+		}
+	}
+	return opened;
+}
+
+/* a count and a reveal kernel with the board size built in */
+#define BOARD_PRESET(w, h) \
+static void \
+countneighbors_##w##x##h(struct board *board) \
+{ \
+	presetcount(board, PRESET_WORDS(w, h), (w) + 2); \
+} \
+static size_t \
+reveal_##w##x##h(struct board *board, size_t i) \
+{ \
+	return presetreveal(board, i, PRESET_WORDS(w, h), (w) + 2); \
+}
+
+BOARD_PRESET(9, 9)
+BOARD_PRESET(10, 10)
+BOARD_PRESET(15, 15)
+BOARD_PRESET(16, 16)
+BOARD_PRESET(30, 16)
+
+static const struct board_preset presets[] =
+{
+	{ 9, 9, countneighbors_9x9, reveal_9x9 },	/* beginner */
+	{ 10, 10, countneighbors_10x10, reveal_10x10 },	/* csweeper */
+	{ 15, 15, countneighbors_15x15, reveal_15x15 },	/* ncsweeper */
+	{ 16, 16, countneighbors_16x16, reveal_16x16 },	/* intermediate */
+	{ 30, 16, countneighbors_30x16, reveal_30x16 },	/* expert */
+};
+
+static const struct board_preset *
+findpreset(int width, int height)
+{
+	for (size_t p = 0; p < sizeof presets / sizeof presets[0]; p++)
+	{
+		if (presets[p].width == width && presets[p].height == height)
+			return &presets[p];
+	}
+	return NULL;
+}
+
+static void
+freeregions(struct board *board)
+{
+	free(board->zeroruns);
+	free(board->regionspans);
+	free(board->regionfirst);
+	board->zeroruns = NULL;
+	board->regionspans = NULL;
+	board->regionfirst = NULL;
+	board->zeroruncount = 0;
+	board->regioncount = 0;
+}
+
+size_t
+board_findroot(size_t *parent, size_t r)
+{
+	/* union find root with path halving, odds.c groups its frontier with it too */
+	while (parent[r] != r)
+	{
+		parent[r] = parent[parent[r]];
+		r = parent[r];
+	}
+	return r;
+}
+
+static void
+regionpass(struct board *board, const size_t *rowfirst, size_t *lastend, size_t *next, int fill)
+{
+	/*
+	 * a row of a region is every zero run on that row or the rows either
+	 * side widened by one tile. rows go in order and runs within a row by
+	 * column, so each region's spans come out sorted and overlaps are
+	 * always with the region's last span. counts spans per region when
+	 * not filling, otherwise writes them starting at next[region]
+	 */
+	for (int y = 0; y < board->height; y++)
+	{
+		size_t at[3], end[3], base[3];
+		for (int k = 0; k < 3; k++)
+		{
+			int row = y + k - 1;
+			at[k] = end[k] = base[k] = 0;
+			if (row >= 0 && row < board->height)
+			{
+				at[k] = rowfirst[row];
+				end[k] = rowfirst[row+1];
+				base[k] = board_index(board, 0, row);
+			}
+		}
+		for (;;)
+		{
+			/* the next run by column out of the three rows */
+			int pick = -1;
+			size_t col = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				if (at[k] == end[k])
+					continue;
+				size_t c = board->zeroruns[at[k]].start - base[k];
+				if (pick < 0 || c < col)
+				{
+					pick = k;
+					col = c;
+				}
+			}
+			if (pick < 0)
+				break;
+			const struct board_span *run = &board->zeroruns[at[pick]++];
+			size_t lo = col > 0 ? col - 1 : 0;
+			size_t hi = col + run->length < (size_t)board->width ? col + run->length : (size_t)board->width - 1;
+			size_t s = board_index(board, lo, y), e = board_index(board, hi, y);
+			size_t r = run->region;
+			if (lastend[r] && s <= lastend[r] + 1)
+			{
+				if (e > lastend[r])
+				{
+					if (fill)
+						board->regionspans[next[r]-1].length = e - board->regionspans[next[r]-1].start + 1;
+					lastend[r] = e;
+				}
+				continue;
+			}
+			if (fill)
+			{
+				board->regionspans[next[r]].start = s;
+				board->regionspans[next[r]].length = e - s + 1;
+				board->regionspans[next[r]].region = r;
+			}
+			next[r]++;
+			lastend[r] = e;
+		}
+	}
+}
+
+int
+board_labelregions(struct board *board)
+{
+	/*
+	 * find every connected group of zero tiles once, after the counts are
+	 * known, so a reveal can open a whole group and its numbered border from
+	 * a list of spans instead of flooding. zero runs are joined to the runs
+	 * they touch on the row above with union-find
+	 */
+	size_t stride = board->stride;
+	size_t cap = 64, count = 0;
+	size_t *rowfirst = malloc((board->height + 1) * sizeof(size_t));
+	struct board_span *runs = malloc(cap * sizeof(struct board_span));
+	size_t *parent = NULL, *lastend = NULL, *next = NULL;
+	freeregions(board);
+	if (!rowfirst || !runs)
+		goto fail;
+	for (int y = 0; y < board->height; y++)
+	{
+		rowfirst[y] = count;
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t i = board_index(board, x, y);
+			if (BOARD_TEST(board->mine, i) || board_countat(board, i) != 0)
+				continue;
+			if (count && runs[count-1].start + runs[count-1].length == i)
+			{
+				runs[count-1].length++;
+				continue;
+			}
+			if (count == cap)
+			{
+				struct board_span *grown = realloc(runs, cap * 2 * sizeof(struct board_span));
+				if (!grown)
+					goto fail;
+				runs = grown;
+				cap *= 2;
+			}
+			runs[count].start = i;
+			runs[count].length = 1;
+			count++;
+		}
+	}
+	rowfirst[board->height] = count;
+
+	parent = malloc((count ? count : 1) * sizeof(size_t));
+	if (!parent)
+		goto fail;
+	for (size_t r = 0; r < count; r++)
+		parent[r] = r;
+	for (int y = 1; y < board->height; y++)
+	{
+		/* runs touch diagonally too, so a one tile overlap either side counts */
+		size_t p = rowfirst[y-1];
+		for (size_t c = rowfirst[y]; c < rowfirst[y+1]; c++)
+		{
+			size_t lo = runs[c].start - stride - 1, hi = runs[c].start + runs[c].length - stride;
+			while (p < rowfirst[y] && runs[p].start + runs[p].length - 1 < lo)
+				p++;
+			for (size_t q = p; q < rowfirst[y] && runs[q].start <= hi; q++)
+			{
+				size_t a = board_findroot(parent, q), b = board_findroot(parent, c);
+				if (a != b)
+					parent[a > b ? a : b] = a < b ? a : b;
+			}
+		}
+	}
+	/* roots are always the lowest run of their region, so regions number in index order */
+	size_t regions = 0;
+	for (size_t r = 0; r < count; r++)
+	{
+		if (board_findroot(parent, r) == r)
+			runs[r].region = regions++;
+		else
+			runs[r].region = runs[board_findroot(parent, r)].region;
+	}
+
+	board->zeroruns = runs;
+	board->zeroruncount = count;
+	lastend = calloc(regions ? regions : 1, sizeof(size_t));
+	next = calloc(regions + 1, sizeof(size_t));
+	board->regionfirst = malloc((regions + 1) * sizeof(size_t));
+	if (!lastend || !next || !board->regionfirst)
+		goto fail;
+	regionpass(board, rowfirst, lastend, next, 0);
+	size_t spans = 0;
+	for (size_t r = 0; r < regions; r++)
+	{
+		board->regionfirst[r] = spans;
+		spans += next[r];
+		next[r] = board->regionfirst[r];
+		lastend[r] = 0;
+	}
+	board->regionfirst[regions] = spans;
+	board->regionspans = malloc((spans ? spans : 1) * sizeof(struct board_span));
+	if (!board->regionspans)
+		goto fail;
+	regionpass(board, rowfirst, lastend, next, 1);
+	board->regioncount = regions;
+	free(rowfirst);
+	free(parent);
+	free(lastend);
+	free(next);
+	return 1;
+
+fail:
+	if (runs != board->zeroruns)
+		free(runs);
+	freeregions(board);
+	free(rowfirst);
+	free(parent);
+	free(lastend);
+	free(next);
+	return 0;
+}
+
+static size_t
+openspan(struct board *board, size_t start, size_t length)
+{
+	/* clear hidden bits a word at a time, returning how many were set */
+	size_t end = start + length, opened = 0;
+	while (start < end)
+	{
+		size_t w = start >> 6;
+		int off = start & 63;
+		size_t n = end - start < (size_t)(64 - off) ? end - start : (size_t)(64 - off);
+		uint64_t mask = (n == 64 ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1) << off;
+		uint64_t bits = board->hidden[w] & mask;
+		board->hidden[w] &= ~mask;
+		opened += board_popcount64(bits);
+		if (board->tracking)
+		{
+			for (; bits; bits &= bits - 1)
+				markchanged(board, (w << 6) + board_ctz64(bits));
+		}
+		start += n;
+	}
+	return opened;
+}
+
+static size_t
+regionreveal(struct board *board, size_t i)
+{
+	/* the zero run holding i by binary search, then every span of its region */
+	size_t low = 0, high = board->zeroruncount;
+	while (high - low > 1)
+	{
+		size_t mid = (low + high) / 2;
+		if (board->zeroruns[mid].start <= i)
+			low = mid;
+		else
+			high = mid;
+	}
+	size_t r = board->zeroruns[low].region, opened = 0;
+#ifdef BOARD_DEBUG
+	assert(board->zeroruns[low].start <= i && i < board->zeroruns[low].start + board->zeroruns[low].length);
+#endif
+	for (size_t s = board->regionfirst[r]; s < board->regionfirst[r+1]; s++)
+		opened += openspan(board, board->regionspans[s].start, board->regionspans[s].length);
+	return opened;
+}
+
+static size_t
+fastreveal(struct board *board, size_t i)
+{
+	/* open the zero region holding i and its border, any method opens the same tiles */
+	if (board->preset)
+		return board->preset->reveal(board, i);
+	if (board->regioncount)
+		return regionreveal(board, i);
+	return floodreveal(board, i);
+}
+
+#ifdef BOARD_DEBUG
+static size_t
+checkedreveal(struct board *board, size_t i)
+{
+	/* a preset kernel or region lookup must open exactly what the flood fill would */
+	uint64_t *before = malloc(board->words * sizeof(uint64_t));
+	uint64_t *after = malloc(board->words * sizeof(uint64_t));
+	int tracking = board->tracking;
+	size_t count;
+	if (before && after)
+	{
+		memcpy(before, board->hidden, board->words * sizeof(uint64_t));
+		board->tracking = 0;
+		size_t flooded = floodreveal(board, i);
+		memcpy(after, board->hidden, board->words * sizeof(uint64_t));
+		memcpy(board->hidden, before, board->words * sizeof(uint64_t));
+		board->tracking = tracking;
+		count = fastreveal(board, i);
+		assert(count == flooded);
+		assert(memcmp(after, board->hidden, board->words * sizeof(uint64_t)) == 0);
+	}
+	else
+	{
+		count = fastreveal(board, i);
+	}
+	free(before);
+	free(after);
+	return count;
+}
+#endif
+
+int
+board_reveal(struct board *board, int x, int y, size_t *opened)
+{
+	size_t i = board_index(board, x, y);
+	size_t count = 0;
+
+	if (opened)
+		*opened = 0;
+	if (BOARD_TEST(board->mine, i))
+	{
+		BOARD_CLEAR(board->hidden, i);
+		markchanged(board, i);
+		return 1;
+	}
+	/* a revealed zero tile has already had its neighbors opened */
+	if (!BOARD_TEST(board->hidden, i))
+		return 0;
+	if (board_countat(board, i) != 0)
+	{
+		BOARD_CLEAR(board->hidden, i);
+		markchanged(board, i);
+		board->revealed++;
+		if (opened)
+			*opened = 1;
+		return 0;
+	}
+
+#ifdef BOARD_DEBUG
+	count = checkedreveal(board, i);
+#else
+	count = fastreveal(board, i);
+#endif
+	board->revealed += count;
+	if (opened)
+		*opened = count;
+	return 0;
+}
+
+void
+board_revealmines(struct board *board)
+{
+	/* changes are not tracked here, the game is over and gets a full redraw */
+	for (size_t w = 0; w < board->words; w++)
+		board->hidden[w] &= ~board->mine[w];
+}
+
+void
+board_scanwin(const struct board *board, size_t *correctflags, size_t *correcttiles)
+{
+	/* full board scan, only used to check the running counters */
+	*correctflags = 0;
+	*correcttiles = 0;
+	for (size_t w = 0; w < board->words; w++)
+	{
+		uint64_t revealed = ~board->mine[w] & ~board->hidden[w];
+		if (w == board->words-1)
+			revealed &= lastmask(board);
+		*correctflags += board_popcount64(board->mine[w] & board->flagged[w]);
+		*correcttiles += board_popcount64(revealed);
+	}
+	/* sentinels look like revealed safe tiles */
+	*correcttiles -= board->bits - board->tiles;
+}
+
+int
+board_checkwin(const struct board *board)
+{
+#ifdef BOARD_DEBUG
+	size_t correctflags, correcttiles;
+	board_scanwin(board, &correctflags, &correcttiles);
+	assert(correctflags == (size_t)board->correctflags);
+	assert(correcttiles == board->revealed);
+#endif
+	return (board->correctflags == board->minecount) ||
+		(board->revealed == board->tiles - board->minecount);
+}
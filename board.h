@@ -0,0 +1,216 @@
+/*
+ * packed minesweeper board (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rng.h"
+
+enum STATE
+{
+	HIDDEN 	= 1 << 0,
+	MINE	= 1 << 1,
+	FLAGGED	= 1 << 2,
+};
+
+/* a run of tiles in index order, region is only used for zero runs */
+struct board_span
+{
+	size_t start;
+	size_t length;
+	size_t region;
+};
+
+struct board_preset;
+
+/*
+ * a tile is one bit in each of the mine/hidden/flagged planes plus a nibble
+ * in counts. tiles are stored row-major so whole-board scans walk the planes
+ * a word at a time, with a one tile sentinel border around the board so every
+ * real tile has eight neighbors at fixed offsets. revealed and correctflags
+ * are kept up to date by reveal and flag toggles so the win check never has
+ * to scan
+ */
+struct board
+{
+	int width;
+	int height;
+	int minecount;
+	int correctflags;
+	size_t revealed;
+	size_t tiles;
+	int stride;	/* width plus the two sentinel columns */
+	size_t origin;	/* index of tile 0,0 */
+	size_t bits;	/* tiles including sentinels */
+	size_t words;
+	uint64_t *mine;
+	uint64_t *hidden;
+	uint64_t *flagged;
+	uint8_t *counts;
+	/*
+	 * fixed size kernels for the standard board sizes, NULL for any other
+	 * size. zero marks the tiles with no neighboring mines and is only kept
+	 * for preset boards
+	 */
+	const struct board_preset *preset;
+	uint64_t *zero;
+	size_t *seeds;
+	size_t seedcount;
+	size_t seedcap;
+	/* tiles opened or flagged since the last board_clearchanges() */
+	int tracking;
+	int changesdropped;
+	size_t *changes;
+	size_t changecount;
+	size_t changecap;
+	/*
+	 * connected zero tiles, see board_labelregions(). zeroruns are the runs
+	 * of zero tiles in index order, regionspans[regionfirst[r]] up to
+	 * regionfirst[r+1] are the tiles a click anywhere in region r opens
+	 */
+	struct board_span *zeroruns;
+	size_t zeroruncount;
+	struct board_span *regionspans;
+	size_t *regionfirst;
+	size_t regioncount;
+};
+
+/* unpacked copy of a single tile, filled in by board_gettileat() */
+struct tile
+{
+	enum STATE state;
+	int neighbormines;
+};
+
+int board_init(struct board *board, int width, int height);
+void board_free(struct board *board);
+void board_reset(struct board *board);
+void board_sethidden(struct board *board, int x, int y, int hidden);
+void board_setmine(struct board *board, int x, int y);
+void board_placemines(struct board *board, int count, struct rng *rng);
+void board_toggleflag(struct board *board, int x, int y);
+void board_countneighbors(struct board *board);
+int board_labelregions(struct board *board);
+int board_reveal(struct board *board, int x, int y, size_t *opened);
+void board_revealmines(struct board *board);
+void board_trackchanges(struct board *board, int enable);
+void board_clearchanges(struct board *board);
+int board_checkwin(const struct board *board);
+void board_scanwin(const struct board *board, size_t *correctflags, size_t *correcttiles);
+size_t board_findroot(size_t *parent, size_t r);
+
+#define BOARD_TEST(plane, i) (((plane)[(i) >> 6] >> ((i) & 63)) & 1)
+#define BOARD_SET(plane, i) ((plane)[(i) >> 6] |= (uint64_t)1 << ((i) & 63))
+#define BOARD_CLEAR(plane, i) ((plane)[(i) >> 6] &= ~((uint64_t)1 << ((i) & 63)))
+
+static inline int
+board_popcount64(uint64_t word)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ULL);
+	word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+	word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/* the lowest set bit, word must not be 0 */
+static inline int
+board_ctz64(uint64_t word)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	int n = 0;
+	while (!(word & 1))
+	{
+		word >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+static inline int
+board_contains(const struct board *board, int x, int y)
+{
+	return x >= 0 && x < board->width && y >= 0 && y < board->height;
+}
+
+static inline size_t
+board_index(const struct board *board, int x, int y)
+{
+	return board->origin + (size_t)y * board->stride + x;
+}
+
+static inline void
+board_coords(const struct board *board, size_t i, int *x, int *y)
+{
+	*x = (int)(i % board->stride) - 1;
+	*y = (int)(i / board->stride) - 1;
+}
+
+static inline void
+board_neighbors(const struct board *board, size_t i, size_t *neighbors)
+{
+	size_t stride = board->stride;
+	neighbors[0] = i - stride - 1;
+	neighbors[1] = i - stride;
+	neighbors[2] = i - stride + 1;
+	neighbors[3] = i - 1;
+	neighbors[4] = i + 1;
+	neighbors[5] = i + stride - 1;
+	neighbors[6] = i + stride;
+	neighbors[7] = i + stride + 1;
+}
+
+static inline int
+board_countat(const struct board *board, size_t i)
+{
+	return (board->counts[i >> 1] >> ((i & 1) << 2)) & 0xf;
+}
+
+static inline int
+board_neighbormines(const struct board *board, int x, int y)
+{
+	return board_countat(board, board_index(board, x, y));
+}
+
+static inline enum STATE
+board_state(const struct board *board, int x, int y)
+{
+	size_t i = board_index(board, x, y);
+	return (BOARD_TEST(board->hidden, i) ? HIDDEN : 0) |
+		(BOARD_TEST(board->mine, i) ? MINE : 0) |
+		(BOARD_TEST(board->flagged, i) ? FLAGGED : 0);
+}
+
+static inline int
+board_gettileat(const struct board *board, int x, int y, struct tile *tile)
+{
+	if (board->mine == NULL || !board_contains(board, x, y))
+		return 0;
+	tile->state = board_state(board, x, y);
+	tile->neighbormines = board_neighbormines(board, x, y);
+	return 1;
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * checks the neighbor count kernels against a plain count (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "board.h"
+
+#define BOARDS 2000
+
+int plaincount(const struct board *board, int x, int y);
+int checkboard(int width, int height, int minecount, uint64_t seed);
+
+int
+plaincount(const struct board *board, int x, int y)
+{
+	int count = 0;
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			if ((dx || dy) && board_contains(board, x + dx, y + dy) &&
+					(board_state(board, x + dx, y + dy) & MINE))
+				count++;
+		}
+	}
+	return count;
+}
+
+int
+checkboard(int width, int height, int minecount, uint64_t seed)
+{
+	/* returns 0 and says where if board_countneighbors() gets a tile wrong */
+	struct board board;
+	struct rng rng;
+	if (!board_init(&board, width, height))
+	{
+		printf("cannot make a %dx%d board\n", width, height);
+		return 0;
+	}
+	rng_seed(&rng, RNG_XOSHIRO, seed);
+	board_placemines(&board, minecount, &rng);
+	board_countneighbors(&board);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int want = plaincount(&board, x, y);
+			if (board_neighbormines(&board, x, y) != want)
+			{
+				printf("%dx%d with %d mines, seed %llu: tile %d %d counted %d, not %d\n",
+						width, height, minecount, (unsigned long long)seed, x, y,
+						board_neighbormines(&board, x, y), want);
+				board_free(&board);
+				return 0;
+			}
+		}
+	}
+	board_free(&board);
+	return 1;
+}
+
+int
+main()
+{
+	/*
+	 * every preset size, then random sizes. widths up to 100 cover the
+	 * 16 and 32 tile vector loops with every length of scalar tail, and
+	 * rows over 64 tiles span more than one word
+	 */
+	static const int presets[][2] = { { 9, 9 }, { 10, 10 }, { 15, 15 }, { 16, 16 }, { 30, 16 } };
+	struct rng rng;
+	int boards = 0;
+#if defined(BOARDTEST_AVX2) && defined(__GNUC__)
+	/* this file is built without avx2 so the check itself is safe to run */
+	__builtin_cpu_init();
+	if (!__builtin_cpu_supports("avx2"))
+	{
+		puts("no avx2 on this cpu, skipped");
+		return 0;
+	}
+#endif
+	rng_seed(&rng, RNG_XOSHIRO, 1);
+	for (size_t p = 0; p < sizeof presets / sizeof presets[0]; p++)
+	{
+		int tiles = presets[p][0] * presets[p][1];
+		for (int density = 0; density <= 100; density += 10, boards++)
+		{
+			if (!checkboard(presets[p][0], presets[p][1], tiles * density / 100, rng_next(&rng)))
+				return 1;
+		}
+	}
+	for (; boards < BOARDS; boards++)
+	{
+		int width = 1 + rng_below(&rng, 100);
+		int height = 1 + rng_below(&rng, 40);
+		int minecount = rng_below(&rng, (uint64_t)width * height + 1);
+		if (!checkboard(width, height, minecount, rng_next(&rng)))
+			return 1;
+	}
+	printf("%d boards counted correctly\n", boards);
+	return 0;
+}
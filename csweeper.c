@@ -19,129 +19,406 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include "board.h"
+#include "noguess.h"
 
 #define WIDTH 10
 #define HEIGHT 10
 #define MINECOUNT 17
+#define BATCHBUF (1 << 20)
 
-enum STATE
+/* board size, WIDTH by HEIGHT unless given on the command line */
+struct game
 {
-	HIDDEN 	= 1 << 0,
-	MINE	= 1 << 1,
-	FLAGGED	= 1 << 2,
-	BLANK 	= 1 << 3,
-};
+	int width;
+	int height;
+	int minecount;
+	int seeded;	/* -seed was given, so the no-guess cache is skipped */
+	const char *cache;	/* no-guess boards, NULL for random ones */
+	int startx, starty;	/* the safe first click of a no-guess board */
+	enum RNG_TYPE rng;
+	int regions;	/* label zero regions up front, -regions */
+} game = { WIDTH, HEIGHT, MINECOUNT, 0, NULL, 0, 0, RNG_XOSHIRO, 0 };
 
-struct tile
+struct board board;
+unsigned long long seed;
+
+/* the part of the board that is printed, all of it unless the terminal is too small */
+struct view
 {
-	enum STATE state;
-	int x, y;
-	int neighbormines;
-};
+	int x, y;	/* top left tile */
+	int width, height;
+	int termcols;
+} view;
 
-struct tile board[WIDTH][HEIGHT] = {0};
+/*
+ * the board is composed into a grid of characters and only the cells that
+ * differ from the last frame are sent, as one write. after a frame the
+ * cursor sits on the line below it where the prompt goes
+ */
+struct frame
+{
+	char *cells;
+	char *prev;	/* what is on screen, prevrows is 0 before the first frame */
+	int rows, cols;
+	int prevrows, prevcols;
+	char *out;
+	size_t len, cap;
+} frame;
 
-void generateboard();
+int generateboard();
+int parsemove(const char *p, const char *end, int *flagging, int *x, int *y);
+int playmove(int flagging, int x, int y, size_t *opened);
+int runbatch(const char *path, int results);
+void sizeview();
+void scrollview(int x, int y);
+int digits(int n);
+int frame_begin(int rows, int cols);
+void frame_printf(int row, int *col, const char *fmt, ...);
+void frame_append(const char *text, size_t len);
+void frame_flush();
+void frame_free();
+void drawlabels(int row, int width);
 void drawboard();
-int reveal(int x, int y);
-void revealmines();
-struct tile *getneighbors(struct tile *tile, struct tile **neighbors);
-struct tile *gettileat(int x, int y);
-int checkwin();
 
-struct tile *getneighbors(struct tile *tile, struct tile **neighbors)
+int
+generateboard()
 {
-	int badup = 0, baddown = 0, badleft = 0, badright = 0;
-	if (tile->x-1<0) badleft = 1;
-	if (tile->x+1>WIDTH-1) badright = 1;
-
-	if (tile->y-1<0) badup = 1;
-	if (tile->y+1>HEIGHT-1) baddown = 1;
-
-	if (!badleft && !badup) neighbors[0] = gettileat(tile->x-1, tile->y-1);
-	if (!badup) neighbors[1] = gettileat(tile->x, tile->y-1);
-	if (!badright && !badup) neighbors[2] = gettileat(tile->x+1, tile->y-1);
-
-	if (!badleft) neighbors[3] = gettileat(tile->x-1, tile->y);
-	if (!badright) neighbors[4] = gettileat(tile->x+1, tile->y);
+	if (game.cache)
+	{
+		/* a cached board if there is one, a seed given on the command line is always generated */
+		struct noguess_board ng = { game.width, game.height, game.minecount,
+			game.width / 2, game.height / 2, seed, 0, game.rng };
+		if (!(!game.seeded && noguess_take(game.cache, &ng)) && !noguess_generate(&ng, 0))
+			return 0;
+		if (!noguess_build(&board, &ng))
+			return 0;
+		seed = ng.seed;
+		game.startx = ng.x;
+		game.starty = ng.y;
+	}
+	else
+	{
+		struct rng rng;
+		rng_seed(&rng, game.rng, seed);
+		if (!board_init(&board, game.width, game.height))
+			return 0;
 
-	if (!badleft && !baddown) neighbors[5] = gettileat(tile->x-1, tile->y+1);
-	if (!baddown) neighbors[6] = gettileat(tile->x, tile->y+1);
-	if (!badright && !baddown) neighbors[7] = gettileat(tile->x+1, tile->y+1);
+		/* place mines */
+		board_placemines(&board, game.minecount, &rng);
+		/* figure out neighbors, noguess_build() does its own */
+		board_countneighbors(&board);
+	}
 
-	return *neighbors;
+	/*
+	 * zero regions cost a pass over the whole board before the first move,
+	 * reveals flood fill without them and preset sizes use their kernel
+	 */
+	if (game.regions && !board.preset)
+		board_labelregions(&board);
+	return 1;
 }
 
 int
-checkwin()
+parsemove(const char *p, const char *end, int *flagging, int *x, int *y)
 {
+	/*
+	 * "x y" or "f x y" read straight out of the input buffer, returns 1 for
+	 * a move, 0 for a malformed line and -1 for a blank one
+	 */
+	int *out[2] = { x, y };
+	*flagging = 0;
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	if (p == end)
+		return -1;
+	if (*p == 'f')
+	{
+		*flagging = 1;
+		p++;
+	}
+	for (int n = 0; n < 2; n++)
+	{
+		const char *start;
+		long value = 0;
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		for (start = p; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			value = value * 10 + (*p - '0');
+			if (value > INT_MAX)
+				return 0;
+		}
+		if (p == start)
+			return 0;
+		*out[n] = value;
+	}
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p == end;
+}
 
-	int allowedmines = MINECOUNT;
-	int safetiles = (HEIGHT * WIDTH) - MINECOUNT;
-	int correctflags = 0;
-	int correcttiles = 0;
+int
+playmove(int flagging, int x, int y, size_t *opened)
+{
+	/* returns 1 if a mine was revealed, moves on shown or flagged tiles do nothing */
+	struct tile tile;
+	int valid = board_gettileat(&board, x, y, &tile);
+	*opened = 0;
+	if (flagging)
+	{
+		if (valid && tile.state & HIDDEN)
+			board_toggleflag(&board, x, y); /* toggle flagged flag */
+		return 0;
+	}
+	if (valid && !(tile.state & FLAGGED))
+		return board_reveal(&board, x, y, opened);
+	return 0;
+}
 
-	for (int y = 0; y < HEIGHT; y++)
+int
+runbatch(const char *path, int results)
+{
+	/*
+	 * apply moves from a file or stdin without drawing. input is read in
+	 * large blocks and lines are parsed where they lie, only a line split
+	 * across two reads is moved. prints a line per move when results is
+	 * set, otherwise only the final board
+	 */
+	int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+	char *buf = malloc(BATCHBUF);
+	unsigned long moves = 0, bad = 0;
+	size_t len = 0;
+	int dead = 0, won = 0, eof = 0;
+	if (fd < 0 || !buf)
+	{
+		printf("cannot read %s\n", path);
+		free(buf);
+		return 0;
+	}
+	setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+	while (!eof && !dead && !won)
 	{
-		for (int x = 0; x < WIDTH; x++)
+		ssize_t n = read(fd, buf + len, BATCHBUF - len);
+		if (n < 0)
+			break;
+		eof = n == 0;
+		len += n;
+		char *p = buf, *end = buf + len;
+		while (p < end && !dead && !won)
 		{
-			struct tile *tile = gettileat(x, y);
-			if (tile->state & MINE && tile->state & FLAGGED)
-				correctflags++;
-			else if (!(tile->state & MINE) && !(tile->state & HIDDEN))
-				correcttiles++;
+			char *nl = memchr(p, '\n', end - p);
+			if (!nl && !eof && (p > buf || len < BATCHBUF))
+				break;
+			/* a line longer than the whole buffer is cut and counted as bad */
+			char *stop = nl ? nl : end;
+			int flagging, x, y;
+			int ok = parsemove(p, stop, &flagging, &x, &y);
+			p = nl ? nl + 1 : end;
+			if (ok < 0)
+				continue;
+			if (ok == 0 || !board_contains(&board, x, y))
+			{
+				bad++;
+				if (results)
+					printf("%lu bad\n", moves + bad);
+				continue;
+			}
+			size_t opened;
+			moves++;
+			dead = playmove(flagging, x, y, &opened);
+			won = !dead && board_checkwin(&board);
+			if (!results)
+				continue;
+			if (dead)
+				printf("%lu %c %d %d mine\n", moves + bad, flagging ? 'f' : 'r', x, y);
+			else if (flagging)
+				printf("%lu f %d %d %s\n", moves + bad, x, y,
+						(board_state(&board, x, y) & FLAGGED) ? "flagged" : "unflagged");
+			else
+				printf("%lu r %d %d %zu\n", moves + bad, x, y, opened);
 		}
+		len = end - p;
+		memmove(buf, p, len);
 	}
+	if (fd != STDIN_FILENO)
+		close(fd);
+	free(buf);
 
-	return (correctflags == allowedmines) || (correcttiles == safetiles);
+	if (dead || won)
+		board_revealmines(&board);
+	if (!results)
+	{
+		/* the whole board, whatever the terminal size */
+		view.x = view.y = 0;
+		view.width = board.width;
+		view.height = board.height;
+		view.termcols = 0;
+		drawboard();
+	}
+	printf("%s after %lu moves, %lu bad, %zu tiles revealed\n",
+			won ? "won" : dead ? "lost" : "unfinished", moves, bad, board.revealed);
+	return 1;
 }
 
-void
-generateboard()
+int
+digits(int n)
 {
-	srand(time(NULL));
-
-	/* place mines */
-	//printf("mines at: ");
-	for (int x = 0; x < MINECOUNT; x++)
+	int d = 1;
+	while (n >= 10)
 	{
-		int mx, my;
-		mx = rand() % WIDTH;
-		my = rand() % HEIGHT;
-		struct tile *tile = gettileat(mx ,my);
-		tile->state |= MINE;
-		//printf("%d, %d : ", mx, my);
+		n /= 10;
+		d++;
 	}
-	puts("");
+	return d;
+}
 
-	/* figure out neighbors */
-	for (int y = 0; y < HEIGHT; y++)
+void
+sizeview()
+{
+	/*
+	 * leave room for the coordinate rows, the view line, the prompt and the
+	 * line the player's enter moves to
+	 */
+	struct winsize ws;
+	int rows = 24, cols = 80;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col)
 	{
-		for (int x = 0; x < WIDTH; x++)
-		{
-			struct tile *tile = gettileat(x, y);
-			tile->x = x;
-			tile->y = y;
-			tile->state |= HIDDEN;
-			struct tile *neighbors[8] = {NULL};
-			getneighbors(tile, neighbors);
-			tile->neighbormines = 0;
-			for (int i = 0; i < 8; i++)
-				if (neighbors[i] != NULL && neighbors[i]->state & MINE)
-					tile->neighbormines += 1;
-			//if (tile->neighbormines == 0 && !(tile->state & MINE))
-				//printf("%d,%d ", tile->x, tile->y);
-		}
+		rows = ws.ws_row;
+		cols = ws.ws_col;
 	}
-	puts("");
+	view.termcols = cols;
+	view.height = rows - 7 > 1 ? rows - 7 : 1;
+	view.width = (cols - 2*digits(board.height-1) - 4) / 3;
+	if (view.width < 1)
+		view.width = 1;
+	if (view.height > board.height)
+		view.height = board.height;
+	if (view.width > board.width)
+		view.width = board.width;
+	scrollview(view.x, view.y);
+}
 
+void
+scrollview(int x, int y)
+{
+	/* recentre on x, y if it is off screen, without passing the board edge */
+	if (x < view.x || x >= view.x + view.width)
+		view.x = x - view.width / 2;
+	if (y < view.y || y >= view.y + view.height)
+		view.y = y - view.height / 2;
+	if (view.x > board.width - view.width)
+		view.x = board.width - view.width;
+	if (view.y > board.height - view.height)
+		view.y = board.height - view.height;
+	if (view.x < 0)
+		view.x = 0;
+	if (view.y < 0)
+		view.y = 0;
 }
 
 int
-main(void)
+main(int argc, char **argv)
 {
-	int dead = 0;
-	generateboard();
+	int dead = 0, results = 0;
+	long fill = 0;
+	const char *batch = NULL;
+	seed = time(NULL);
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "-seed") == 0 && arg+1 < argc)
+		{
+			seed = strtoull(argv[++arg], NULL, 0);
+			game.seeded = 1;
+		}
+		else if (strcmp(argv[arg], "-width") == 0 && arg+1 < argc)
+		{
+			game.width = atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-height") == 0 && arg+1 < argc)
+		{
+			game.height = atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-mines") == 0 && arg+1 < argc)
+		{
+			game.minecount = atoi(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-batch") == 0 && arg+1 < argc)
+		{
+			batch = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "-results") == 0)
+		{
+			results = 1;
+		}
+		else if (strcmp(argv[arg], "-regions") == 0)
+		{
+			game.regions = 1;
+		}
+		else if (strcmp(argv[arg], "-noguess") == 0 && arg+1 < argc)
+		{
+			game.cache = argv[++arg];
+		}
+		else if (strcmp(argv[arg], "-fill") == 0 && arg+1 < argc)
+		{
+			fill = atol(argv[++arg]);
+		}
+		else if (strcmp(argv[arg], "-rng") == 0 && arg+1 < argc && rng_parse(argv[arg+1], &game.rng))
+		{
+			arg++;
+		}
+		else
+		{
+			printf("usage: %s [-seed n] [-rng xoshiro|pcg] [-width w] [-height h] [-mines n] [-regions] [-noguess cache [-fill n]] [-batch moves.txt|- [-results]]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (game.width <= 0 || game.height <= 0 || game.minecount <= 0 ||
+			(long long)game.minecount >= (long long)game.width * game.height)
+	{
+		puts("the board needs a width and height of at least 1 and fewer mines than tiles");
+		return 1;
+	}
+	if (fill > 0 && game.cache)
+	{
+		/* boards for later games, from consecutive seeds */
+		for (long n = 0; n < fill; n++)
+		{
+			struct noguess_board ng = { game.width, game.height, game.minecount,
+				game.width / 2, game.height / 2, seed + n, 0, game.rng };
+			if (!noguess_generate(&ng, 0) || !noguess_store(game.cache, &ng))
+			{
+				printf("cannot add a board to %s\n", game.cache);
+				return 1;
+			}
+		}
+		printf("added %ld boards to %s\n", fill, game.cache);
+		return 0;
+	}
+	if (!generateboard())
+	{
+		puts("cannot generate board");
+		return 1;
+	}
+	if (batch)
+	{
+		int ok = runbatch(batch, results);
+		board_free(&board);
+		frame_free();
+		return !ok;
+	}
+	printf("seed: %llu\n", seed);
+	if (game.rng != RNG_XOSHIRO)
+		printf("rng: %s\n", rng_name(game.rng));
+	if (game.cache)
+		printf("no guessing needed if you start at %d %d\n", game.startx, game.starty);
+	puts("");
+	sizeview();
 	puts("reveal every safe tile or flag every mine to win.\nto (un)flag the tile at 3,7 enter 'f 3 7'\n" \
 		"to reveal tile at 5,5 enter '5 5'\n");
 	drawboard();
@@ -150,7 +427,8 @@ main(void)
 		char input[512];
 		int desx = 0, desy = 0, flagging = 0, xset = 0;
 		printf("> ");
-		fgets(input, 412, stdin);
+		if (!fgets(input, 412, stdin))
+			break;
 		char* token = strtok(input, " ");
 		while (token)
 		{
@@ -169,128 +447,234 @@ main(void)
 			}
 			token = strtok(NULL, " ");
 		}
-		struct tile *tile = gettileat(desx, desy);
+		struct tile tile;
+		int valid = board_gettileat(&board, desx, desy, &tile);
+		sizeview();
+		if (valid)
+			scrollview(desx, desy);
 		if (flagging)
 		{
-			if (tile && tile->state & HIDDEN)
-				gettileat(desx, desy)->state ^= FLAGGED; /* toggle flagged flag */
+			if (valid && tile.state & HIDDEN)
+				board_toggleflag(&board, desx, desy); /* toggle flagged flag */
 		}
 		else
 		{
-			if (tile && !(tile->state & FLAGGED))
-				dead = reveal(tile->x, tile->y);
+			if (valid && !(tile.state & FLAGGED))
+				dead = board_reveal(&board, desx, desy, NULL);
 		}
-		printf("\033[15A");
-		printf("\033[J");
-		drawboard();
-		if (checkwin())
+		if (board_checkwin(&board))
 		{
-			revealmines();
-			printf("\033[15A");
-			printf("\033[J");
+			board_revealmines(&board);
 			drawboard();
 			printf("you win\n");
 			break;
 		}
 		else if (dead == 1)
 		{
-			revealmines();
-			printf("\033[15A");
-			printf("\033[J");
+			board_revealmines(&board);
 			drawboard();
 			printf("you lose\n");
 		}
+		else
+		{
+			drawboard();
+		}
 	}
+	board_free(&board);
+	frame_free();
 	return 1;
 }
 
-struct tile *
-gettileat(int x, int y)
+int
+frame_begin(int rows, int cols)
 {
-	if (x < 0 || x > WIDTH-1 || y < 0 || y > HEIGHT-1)
-		return NULL;
-	return &board[x][y];
+	/* a blank frame, the buffers are kept and only grow */
+	if ((size_t)rows * cols > (size_t)frame.rows * frame.cols || !frame.cells)
+	{
+		char *cells = realloc(frame.cells, (size_t)rows * cols);
+		if (!cells)
+			return 0;
+		frame.cells = cells;
+		char *prev = realloc(frame.prev, (size_t)rows * cols);
+		if (!prev)
+			return 0;
+		frame.prev = prev;
+	}
+	frame.rows = rows;
+	frame.cols = cols;
+	memset(frame.cells, ' ', (size_t)rows * cols);
+	return 1;
 }
 
-int
-reveal(int x, int y)
+void
+frame_printf(int row, int *col, const char *fmt, ...)
 {
-	struct tile *tile = gettileat(x, y);
-	tile->state &= ~HIDDEN;
-	if (tile->state & MINE)
-		return 1;
-	if (tile->neighbormines == 0)
+	char text[64];
+	va_list ap;
+	va_start(ap, fmt);
+	int len = vsnprintf(text, sizeof text, fmt, ap);
+	va_end(ap);
+	if (len > (int)sizeof text - 1)
+		len = sizeof text - 1;
+	if (len > frame.cols - *col)
+		len = frame.cols - *col;
+	if (len > 0)
+		memcpy(frame.cells + (size_t)row * frame.cols + *col, text, len);
+	*col += len > 0 ? len : 0;
+}
+
+void
+frame_append(const char *text, size_t len)
+{
+	if (frame.len + len > frame.cap)
 	{
-		tile->state &= ~HIDDEN;
-		struct tile *neighbors[8] = {NULL};
-		getneighbors(tile, neighbors);
-		for (int nc = 0; nc < 8; nc++)
-		{
-			struct tile *neighbor = neighbors[nc];
-			if (neighbor != NULL && !(neighbor->state & MINE) && neighbor->state & HIDDEN)
-			{
-				neighbor->state &= ~HIDDEN;
-				if (neighbor->neighbormines == 0)
-				{
-					reveal(neighbor->x, neighbor->y);
-				}
-			}
-		}
+		size_t cap = frame.cap ? frame.cap * 2 : 4096;
+		while (cap < frame.len + len)
+			cap *= 2;
+		char *out = realloc(frame.out, cap);
+		if (!out)
+			return;
+		frame.out = out;
+		frame.cap = cap;
 	}
-	return 0;
+	memcpy(frame.out + frame.len, text, len);
+	frame.len += len;
 }
 
 void
-revealmines()
-{	for (int y = 0; y < HEIGHT; y++)
+frame_flush()
+{
+	/*
+	 * the cursor is below the prompt line the player typed on, so the last
+	 * frame starts prevrows+1 lines up. a frame of a different shape is
+	 * printed whole, otherwise each run of changed cells is one column jump
+	 * and the characters themselves
+	 */
+	char move[32];
+	frame.len = 0;
+	if (frame.prevrows)
+		frame_append(move, snprintf(move, sizeof move, "\033[%dA\r", frame.prevrows+1));
+	if (frame.rows != frame.prevrows || frame.cols != frame.prevcols)
+	{
+		/* the first frame goes out as plain text */
+		if (frame.prevrows)
+			frame_append("\033[J", 3);
+		for (int r = 0; r < frame.rows; r++)
+		{
+			const char *row = frame.cells + (size_t)r * frame.cols;
+			int len = frame.cols;
+			while (len > 0 && row[len-1] == ' ')
+				len--;
+			frame_append(row, len);
+			frame_append("\n", 1);
+		}
+	}
+	else
 	{
-		for (int x = 0; x < WIDTH; x++)
+		int at = 0;
+		for (int r = 0; r < frame.rows; r++)
 		{
-			if (gettileat(x, y)->state & MINE)
-				reveal(x, y);
+			const char *row = frame.cells + (size_t)r * frame.cols;
+			const char *old = frame.prev + (size_t)r * frame.cols;
+			for (int c = 0; c < frame.cols; c++)
+			{
+				if (row[c] == old[c])
+					continue;
+				int end = c;
+				while (end < frame.cols && row[end] != old[end])
+					end++;
+				if (r != at)
+					frame_append(move, snprintf(move, sizeof move, "\033[%dB", r - at));
+				at = r;
+				frame_append(move, snprintf(move, sizeof move, "\033[%dG", c+1));
+				frame_append(row + c, end - c);
+				c = end;
+			}
 		}
+		if (frame.rows != at)
+			frame_append(move, snprintf(move, sizeof move, "\033[%dB", frame.rows - at));
+		frame_append("\r\033[J", 4);
 	}
+
+	fflush(stdout);
+	for (size_t done = 0; done < frame.len;)
+	{
+		ssize_t n = write(STDOUT_FILENO, frame.out + done, frame.len - done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	char *prev = frame.prev;
+	frame.prev = frame.cells;
+	frame.cells = prev;
+	frame.prevrows = frame.rows;
+	frame.prevcols = frame.cols;
+}
+
+void
+frame_free()
+{
+	free(frame.cells);
+	free(frame.prev);
+	free(frame.out);
+	memset(&frame, 0, sizeof frame);
+}
+
+void
+drawlabels(int row, int width)
+{
+	int col = width+2;
+	for (int x = view.x; x < view.x + view.width; x++)
+		frame_printf(row, &col, "%2d ", x % 100);
 }
 
 void
 drawboard()
-{ 
-	printf("   ");
-	for (int i = 0; i < WIDTH; i++)
-		printf(" %d ", i);
-	puts("");
-	printf("   ");
-	for (int i = 0; i < WIDTH; i++)
-		printf("---");
-	puts("");
+{
+	/* only the tiles in view are composed, then sent as one diffed write */
+	int width = digits(board.height-1), row = 0;
+	int rows = 4 + view.height, cols = width + 4 + view.width*3 + digits(board.height-1);
+	int partial = view.width < board.width || view.height < board.height;
+	if (partial)
+		rows++;
+	/* room for the view line, but never wider than the terminal or lines would wrap */
+	if (cols < 48)
+		cols = 48;
+	if (cols > view.termcols && view.termcols > 0)
+		cols = view.termcols;
+	if (!frame_begin(rows, cols))
+		return;
 
-	for (int y = 0; y < HEIGHT; y++)
+	drawlabels(row++, width);
+	memset(frame.cells + (size_t)row++ * cols + width+2, '-', view.width*3);
+	for (int y = view.y; y < view.y + view.height; y++, row++)
 	{
-		printf("%d |", y);
-		for (int x = 0; x < WIDTH; x++)
+		int col = 0;
+		frame_printf(row, &col, "%*d |", width, y);
+		for (int x = view.x; x < view.x + view.width; x++)
 		{
-			struct tile *tile = gettileat(x, y);
-			char neighbormines = (char)tile->neighbormines+'0';
+			enum STATE state = board_state(&board, x, y);
+			char neighbormines = (char)board_neighbormines(&board, x, y)+'0';
 			if (neighbormines == '0')
 				neighbormines = ' ';
-			if (tile->state & FLAGGED)
-				printf(" F ");
-			else if (tile->state & HIDDEN)
-				printf(" . ");
-			else
-				printf(" %c ", (tile->state & MINE) ? 'M' :neighbormines); 
+			if (state & FLAGGED)
+				neighbormines = 'F';
+			else if (state & HIDDEN)
+				neighbormines = '.';
+			else if (state & MINE)
+				neighbormines = 'M';
+			frame.cells[(size_t)row * cols + col + 1] = neighbormines;
+			col += 3;
 		}
-		printf("| %d\n", y);
+		frame_printf(row, &col, "| %d", y);
 	}
-
-	printf("   ");
-	for (int i = 0; i < WIDTH; i++)
-		printf("---");
-	puts("");
-	printf("   ");
-	for (int i = 0; i < WIDTH; i++)
-		printf(" %d ", i);
-	puts("");
-
+	memset(frame.cells + (size_t)row++ * cols + width+2, '-', view.width*3);
+	drawlabels(row++, width);
+	if (partial)
+	{
+		int col = 0;
+		frame_printf(row, &col, "view %d-%d, %d-%d of %dx%d", view.x, view.x+view.width-1,
+				view.y, view.y+view.height-1, board.width, board.height);
+	}
+	frame_flush();
 }
-
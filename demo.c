@@ -0,0 +1,794 @@
+/*
+ * ncsweeper demo files (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "demo.h"
+
+struct writer
+{
+	FILE *file;
+	size_t flushed;
+	size_t len;
+	uint8_t buf[DEMO_FLUSH_BYTES * 2];
+};
+
+struct keyframe_offset
+{
+	int action;
+	size_t offset;
+};
+
+struct demo_recorder
+{
+	struct writer writer;
+	const struct board *board;
+	struct keyframe_offset *index;
+	int indexcount;
+	int indexcap;
+	int count;
+	int runlength;
+	enum DEMO_ACTION_TYPE runtype;
+	uint64_t run[DEMO_OP_RUN_MAX];
+	double sinceflush;
+};
+
+struct reader
+{
+	const uint8_t *pos;
+	const uint8_t *end;
+	int bad;
+};
+
+static void flushwriter(struct writer *writer);
+static void putbyte(struct writer *writer, int byte);
+static void putvarint(struct writer *writer, uint64_t value);
+static void putrun(struct demo_recorder *recorder);
+static void flushrecorder(struct demo_recorder *recorder);
+static void putplane(struct writer *writer, const struct board *board, const uint64_t *plane);
+static void putkeyframe(struct demo_recorder *recorder, int x, int y);
+static void putmines(struct writer *writer, const struct board *board);
+static int skipplane(struct reader *reader, size_t tiles);
+static void restoreplane(struct board *board, struct reader *reader, int flagged);
+static int getbyte(struct reader *reader);
+static uint64_t getvarint(struct reader *reader);
+static uint8_t *readfile(const char *filename, size_t *size);
+static void replaycursor(const struct board *board, struct action_log *log);
+static int mineshown(const struct board *board);
+static int loadlegacy(const uint8_t *data, size_t size, struct board *board, struct action_log *log);
+static int loadkeyframe(struct reader *reader, const struct board *board, struct action_log *log);
+static int loadv2(const uint8_t *data, size_t size, struct board *board, struct action_log *log);
+
+void
+actionlog_free(struct action_log *log)
+{
+	free(log->actions);
+	for (int k = 0; k < log->keyframecount; k++)
+		free(log->keyframes[k].planes);
+	free(log->keyframes);
+	memset(log, 0, sizeof *log);
+}
+
+void
+actionlog_reset(struct action_log *log)
+{
+	/* empty the log for another demo, the action buffer is kept */
+	for (int k = 0; k < log->keyframecount; k++)
+		free(log->keyframes[k].planes);
+	log->count = 0;
+	log->keyframecount = 0;
+	log->startx = 0;
+	log->starty = 0;
+}
+
+int
+actionlog_reserve(struct action_log *log, int capacity)
+{
+	if (capacity <= log->capacity)
+		return 1;
+	struct demo_action *actions = realloc(log->actions, sizeof(struct demo_action) * capacity);
+	if (!actions)
+		return 0;
+	log->actions = actions;
+	log->capacity = capacity;
+	return 1;
+}
+
+int
+actionlog_append(struct action_log *log, double delay, enum DEMO_ACTION_TYPE type, int x, int y)
+{
+	if (log->count == log->capacity &&
+			!actionlog_reserve(log, log->capacity ? log->capacity * 2 : 256))
+		return 0;
+	struct demo_action *action = &log->actions[log->count++];
+	action->action_pre_delay = delay;
+	action->start_x = x;
+	action->start_y = y;
+	action->type = type;
+	return 1;
+}
+
+static void
+flushwriter(struct writer *writer)
+{
+	fwrite(writer->buf, 1, writer->len, writer->file);
+	writer->flushed += writer->len;
+	writer->len = 0;
+}
+
+static void
+putbyte(struct writer *writer, int byte)
+{
+	if (writer->len == sizeof writer->buf)
+		flushwriter(writer);
+	writer->buf[writer->len++] = byte;
+}
+
+static void
+putvarint(struct writer *writer, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		putbyte(writer, (value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	putbyte(writer, value);
+}
+
+static int
+getbyte(struct reader *reader)
+{
+	if (reader->pos >= reader->end)
+	{
+		reader->bad = 1;
+		return 0;
+	}
+	return *reader->pos++;
+}
+
+static uint64_t
+getvarint(struct reader *reader)
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = getbyte(reader);
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	reader->bad = 1;
+	return 0;
+}
+
+static uint8_t *
+readfile(const char *filename, size_t *size)
+{
+	/* the whole demo is read with one fread and parsed from memory */
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+		return NULL;
+	uint8_t *data = NULL;
+	long end;
+	if (fseek(file, 0, SEEK_END) == 0 && (end = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+	{
+		*size = end;
+		data = malloc(*size ? *size : 1);
+		if (data && fread(data, 1, *size, file) != *size)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+	fclose(file);
+	return data;
+}
+
+static void
+replaycursor(const struct board *board, struct action_log *log)
+{
+	/*
+	 * version 2 does not store positions, every action happens where the
+	 * cursor is after it, exactly as input() records them
+	 */
+	int x = log->startx, y = log->starty;
+	for (int i = 0; i < log->count; i++)
+	{
+		struct demo_action *action = &log->actions[i];
+		if (action->type == GOUP && y > 0) y--;
+		else if (action->type == GODOWN && y < board->height-1) y++;
+		else if (action->type == GOLEFT && x > 0) x--;
+		else if (action->type == GORIGHT && x < board->width-1) x++;
+		action->start_x = x;
+		action->start_y = y;
+	}
+}
+
+static int
+mineshown(const struct board *board)
+{
+	/* a keyframe taken after the losing reveal */
+	for (size_t w = 0; w < board->words; w++)
+	{
+		if (board->mine[w] & ~board->hidden[w])
+			return 1;
+	}
+	return 0;
+}
+
+static int
+skipplane(struct reader *reader, size_t tiles)
+{
+	size_t seen = 0;
+	while (seen < tiles && !reader->bad)
+	{
+		uint64_t run = getvarint(reader);
+		if (run > tiles - seen)
+			reader->bad = 1;
+		seen += run;
+	}
+	return !reader->bad;
+}
+
+static void
+restoreplane(struct board *board, struct reader *reader, int flagged)
+{
+	/* runs alternate between tiles without and with the bit set */
+	size_t t = 0;
+	int value = 0;
+	while (t < board->tiles)
+	{
+		size_t run = getvarint(reader);
+		for (size_t end = t + run; t < end; t++)
+		{
+			int x = t % board->width, y = t / board->width;
+			if (flagged && value)
+				board_toggleflag(board, x, y);
+			else if (!flagged && !value)
+				board_sethidden(board, x, y, 0);
+		}
+		value = !value;
+	}
+}
+
+static int
+loadkeyframe(struct reader *reader, const struct board *board, struct action_log *log)
+{
+	/* keep the encoded planes, they are only decoded when seeking */
+	struct demo_keyframe key;
+	uint64_t action = getvarint(reader);
+	uint64_t x = getvarint(reader);
+	uint64_t y = getvarint(reader);
+	const uint8_t *start = reader->pos;
+	if (!skipplane(reader, board->tiles) || !skipplane(reader, board->tiles))
+		return 0;
+	if (action != (uint64_t)log->count || !board_contains(board, x, y))
+		return 0;
+	if (log->keyframecount == log->keyframecap)
+	{
+		int cap = log->keyframecap ? log->keyframecap * 2 : 16;
+		struct demo_keyframe *keyframes = realloc(log->keyframes, sizeof(struct demo_keyframe) * cap);
+		if (!keyframes)
+			return 0;
+		log->keyframes = keyframes;
+		log->keyframecap = cap;
+	}
+	key.action = action;
+	key.x = x;
+	key.y = y;
+	key.size = reader->pos - start;
+	key.planes = malloc(key.size);
+	if (!key.planes)
+		return 0;
+	memcpy(key.planes, start, key.size);
+	log->keyframes[log->keyframecount++] = key;
+	return 1;
+}
+
+static int
+loadlegacy(const uint8_t *data, size_t size, struct board *board, struct action_log *log)
+{
+	struct demo_header header;
+	struct demo_mine demo_mine;
+	int action_count;
+	size_t pos = sizeof header;
+
+	if (size < sizeof header)
+		return 0;
+	memcpy(&header, data, sizeof header);
+	if (header.mine_count < 0 || !board_init(board, header.width, header.height))
+		return 0;
+	for (int mc = 0; mc < header.mine_count; mc++, pos += sizeof demo_mine)
+	{
+		if (size - pos < sizeof demo_mine)
+			return 0;
+		memcpy(&demo_mine, data + pos, sizeof demo_mine);
+		if (!board_contains(board, demo_mine.x, demo_mine.y))
+			return 0;
+		board_setmine(board, demo_mine.x, demo_mine.y);
+	}
+	if (size - pos < sizeof action_count)
+		return 0;
+	memcpy(&action_count, data + pos, sizeof action_count);
+	pos += sizeof action_count;
+	if (action_count < 0 || !actionlog_reserve(log, action_count))
+		return 0;
+	/* a short file keeps whatever whole actions it has, as fread did */
+	size_t available = (size - pos) / sizeof(struct demo_action);
+	log->count = (size_t)action_count < available ? action_count : (int)available;
+	memcpy(log->actions, data + pos, sizeof(struct demo_action) * log->count);
+	return 1;
+}
+
+static int
+loadv2(const uint8_t *data, size_t size, struct board *board, struct action_log *log)
+{
+	struct reader reader = { data + 4, data + size, 0 };
+	if (getbyte(&reader) != DEMO_VERSION)
+		return 0;
+	int mines = getbyte(&reader);
+	uint64_t width = getvarint(&reader);
+	uint64_t height = getvarint(&reader);
+	uint64_t minecount = getvarint(&reader);
+	if (reader.bad || width > INT_MAX || height > INT_MAX || minecount > INT_MAX)
+		return 0;
+	if (!board_init(board, width, height))
+		return 0;
+
+	if (mines == DEMO_MINES_BITMAP)
+	{
+		size_t bytes = (board->tiles + 7) / 8;
+		if ((size_t)(reader.end - reader.pos) < bytes)
+			return 0;
+		for (size_t t = 0; t < board->tiles; t++)
+		{
+			if (reader.pos[t >> 3] & (1 << (t & 7)))
+				board_setmine(board, t % board->width, t / board->width);
+		}
+		reader.pos += bytes;
+		if ((uint64_t)board->minecount != minecount)
+			return 0;
+	}
+	else if (mines == DEMO_MINES_SEED)
+	{
+		struct rng rng;
+		int type = getbyte(&reader);
+		uint64_t seed = 0;
+		for (int i = 0; i < 8; i++)
+			seed |= (uint64_t)getbyte(&reader) << (i * 8);
+		if (reader.bad || type >= RNG_COUNT || minecount >= board->tiles)
+			return 0;
+		rng_seed(&rng, type, seed);
+		board_placemines(board, minecount, &rng);
+	}
+	else
+	{
+		return 0;
+	}
+
+	/*
+	 * a demo cut short by a crash has no end op, it keeps every action that
+	 * was completely written
+	 */
+	for (;;)
+	{
+		int op = getbyte(&reader);
+		if (reader.bad)
+			break;
+		if (op == DEMO_OP_END)
+		{
+			/* a count cut off by a crash still keeps the actions before it */
+			uint64_t count = getvarint(&reader);
+			if (!reader.bad && count != (uint64_t)log->count)
+				return 0;
+			break;
+		}
+		if (op == DEMO_OP_KEYFRAME)
+		{
+			/* a keyframe cut off by a crash is dropped like a cut off action */
+			if (!loadkeyframe(&reader, board, log))
+			{
+				if (reader.bad)
+					break;
+				return 0;
+			}
+			continue;
+		}
+		if (op == DEMO_OP_START)
+		{
+			/* only before the first action */
+			uint64_t x = getvarint(&reader);
+			uint64_t y = getvarint(&reader);
+			if (reader.bad)
+				break;
+			if (log->count || !board_contains(board, x, y))
+				return 0;
+			log->startx = x;
+			log->starty = y;
+			continue;
+		}
+		if (op == DEMO_OP_INDEX)
+		{
+			/* keyframes were collected on the way here, the index is for other readers */
+			uint64_t count = getvarint(&reader);
+			for (uint64_t k = 0; k < count && !reader.bad; k++)
+			{
+				getvarint(&reader);
+				getvarint(&reader);
+			}
+			if (reader.bad)
+				break;
+			continue;
+		}
+		if (op & DEMO_OP_CONTROL)
+			return 0;
+		int run = ((op >> 3) & 0x0f) + 1;
+		for (int i = 0; i < run; i++)
+		{
+			uint64_t delay = getvarint(&reader);
+			if (reader.bad)
+				break;
+			if (!actionlog_append(log, delay, op & 0x07, 0, 0))
+				return 0;
+		}
+		if (reader.bad)
+			break;
+	}
+	replaycursor(board, log);
+	return 1;
+}
+
+static void
+putrun(struct demo_recorder *recorder)
+{
+	/* consecutive actions of the same type share one op byte */
+	if (recorder->runlength == 0)
+		return;
+	putbyte(&recorder->writer, recorder->runtype | ((recorder->runlength - 1) << 3));
+	for (int r = 0; r < recorder->runlength; r++)
+		putvarint(&recorder->writer, recorder->run[r]);
+	recorder->runlength = 0;
+}
+
+static void
+putplane(struct writer *writer, const struct board *board, const uint64_t *plane)
+{
+	uint64_t run = 0;
+	int value = 0;
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			if ((int)BOARD_TEST(plane, board_index(board, x, y)) != value)
+			{
+				putvarint(writer, run);
+				run = 0;
+				value = !value;
+			}
+			run++;
+		}
+	}
+	putvarint(writer, run);
+}
+
+static void
+putkeyframe(struct demo_recorder *recorder, int x, int y)
+{
+	struct writer *writer = &recorder->writer;
+	if (recorder->indexcount == recorder->indexcap)
+	{
+		int cap = recorder->indexcap ? recorder->indexcap * 2 : 16;
+		struct keyframe_offset *index = realloc(recorder->index, sizeof(struct keyframe_offset) * cap);
+		if (!index)
+			return;
+		recorder->index = index;
+		recorder->indexcap = cap;
+	}
+	putrun(recorder);
+	recorder->index[recorder->indexcount].action = recorder->count;
+	recorder->index[recorder->indexcount].offset = writer->flushed + writer->len;
+	recorder->indexcount++;
+	putbyte(writer, DEMO_OP_KEYFRAME);
+	putvarint(writer, recorder->count);
+	putvarint(writer, x);
+	putvarint(writer, y);
+	putplane(writer, recorder->board, recorder->board->hidden);
+	putplane(writer, recorder->board, recorder->board->flagged);
+}
+
+static void
+putmines(struct writer *writer, const struct board *board)
+{
+	/* row-major, bit 0 of each byte first */
+	int byte = 0;
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t t = (size_t)y * board->width + x;
+			if (board_state(board, x, y) & MINE)
+				byte |= 1 << (t & 7);
+			if ((t & 7) == 7)
+			{
+				putbyte(writer, byte);
+				byte = 0;
+			}
+		}
+	}
+	if (board->tiles & 7)
+		putbyte(writer, byte);
+}
+
+static void
+flushrecorder(struct demo_recorder *recorder)
+{
+	/* after this everything recorded so far survives the process dying */
+	putrun(recorder);
+	flushwriter(&recorder->writer);
+	fflush(recorder->writer.file);
+	recorder->sinceflush = 0;
+}
+
+struct demo_recorder *
+demo_record_open(const char *filename, const struct board *board, const struct demo_start *start)
+{
+	/* start can be NULL, the mines are then saved as a bitmap */
+	struct demo_recorder *recorder = calloc(1, sizeof *recorder);
+	if (!recorder)
+		return NULL;
+	struct writer *writer = &recorder->writer;
+	recorder->board = board;
+	writer->file = fopen(filename, "wb");
+	if (!writer->file)
+	{
+		free(recorder);
+		return NULL;
+	}
+
+	for (int i = 0; i < 4; i++)
+		putbyte(writer, DEMO_MAGIC[i]);
+	putbyte(writer, DEMO_VERSION);
+	putbyte(writer, start && start->seeded ? DEMO_MINES_SEED : DEMO_MINES_BITMAP);
+	putvarint(writer, board->width);
+	putvarint(writer, board->height);
+	putvarint(writer, board->minecount);
+	if (start && start->seeded)
+	{
+		putbyte(writer, start->rng);
+		for (int i = 0; i < 8; i++)
+			putbyte(writer, (start->seed >> (i * 8)) & 0xff);
+	}
+	else
+	{
+		putmines(writer, board);
+	}
+	if (start && (start->x || start->y))
+	{
+		putbyte(writer, DEMO_OP_START);
+		putvarint(writer, start->x);
+		putvarint(writer, start->y);
+	}
+	flushrecorder(recorder);
+	return recorder;
+}
+
+int
+demo_record_append(struct demo_recorder *recorder, double delay, enum DEMO_ACTION_TYPE type, int x, int y)
+{
+	/* x and y are the cursor after the action, the board is read as it is now */
+	type &= 0x07;
+	if (recorder->runlength == DEMO_OP_RUN_MAX || (recorder->runlength && type != recorder->runtype))
+		putrun(recorder);
+	recorder->runtype = type;
+	recorder->run[recorder->runlength++] = delay > 0 ? (uint64_t)(delay + 0.5) : 0;
+	recorder->count++;
+	if (recorder->count % DEMO_KEYFRAME_INTERVAL == 0)
+		putkeyframe(recorder, x, y);
+	recorder->sinceflush += delay;
+	if (recorder->writer.len >= DEMO_FLUSH_BYTES || recorder->sinceflush >= DEMO_FLUSH_US)
+		flushrecorder(recorder);
+	return !ferror(recorder->writer.file);
+}
+
+int
+demo_record_pending(const struct demo_recorder *recorder)
+{
+	/* actions that would be lost if the process died now */
+	return recorder->runlength > 0 || recorder->writer.len > 0;
+}
+
+int
+demo_record_flush(struct demo_recorder *recorder)
+{
+	flushrecorder(recorder);
+	return !ferror(recorder->writer.file);
+}
+
+int
+demo_record_close(struct demo_recorder *recorder)
+{
+	/* returns the number of actions recorded or -1 if the demo did not make it to disk */
+	putrun(recorder);
+	putbyte(&recorder->writer, DEMO_OP_INDEX);
+	putvarint(&recorder->writer, recorder->indexcount);
+	for (int k = 0; k < recorder->indexcount; k++)
+	{
+		putvarint(&recorder->writer, recorder->index[k].action);
+		putvarint(&recorder->writer, recorder->index[k].offset);
+	}
+	putbyte(&recorder->writer, DEMO_OP_END);
+	putvarint(&recorder->writer, recorder->count);
+	flushwriter(&recorder->writer);
+	int count = ferror(recorder->writer.file) ? -1 : recorder->count;
+	if (fclose(recorder->writer.file) != 0)
+		count = -1;
+	free(recorder->index);
+	free(recorder);
+	return count;
+}
+
+int
+demo_load(const char *filename, struct board *board, struct action_log *log)
+{
+	/* returns 1 on success, 0 if the demo is corrupt and -1 if it cannot be read */
+	size_t size;
+	uint8_t *data = readfile(filename, &size);
+	if (!data)
+		return -1;
+	int ok;
+	if (size >= 4 && memcmp(data, DEMO_MAGIC, 4) == 0)
+		ok = loadv2(data, size, board, log);
+	else
+		ok = loadlegacy(data, size, board, log);
+	free(data);
+	if (!ok)
+	{
+		board_free(board);
+		actionlog_free(log);
+	}
+	return ok;
+}
+
+int
+demo_step(struct demo_game *game, const struct demo_action *action)
+{
+	/* the same rules input() applies to a key, returns 0 for a bad action */
+	struct board *board = game->board;
+	struct tile tile;
+	if (!board_gettileat(board, action->start_x, action->start_y, &tile))
+		return 0;
+	switch (action->type)
+	{
+		case GOUP:
+			if (game->y > 0)
+				game->y--;
+			break;
+		case GODOWN:
+			if (game->y < board->height-1)
+				game->y++;
+			break;
+		case GOLEFT:
+			if (game->x > 0)
+				game->x--;
+			break;
+		case GORIGHT:
+			if (game->x < board->width-1)
+				game->x++;
+			break;
+		case FLAG:
+			if (tile.state & HIDDEN)
+				board_toggleflag(board, action->start_x, action->start_y);
+			break;
+		case REVEAL:
+			if (!(tile.state & FLAGGED) &&
+					board_reveal(board, action->start_x, action->start_y, NULL))
+				game->outcome = DEMO_LOST;
+			break;
+		case QUIT:
+			game->outcome = DEMO_QUIT;
+			break;
+		case NONE:
+		default:
+			break;
+	}
+	if (board_checkwin(board))
+		game->outcome = DEMO_WON;
+	return 1;
+}
+
+int
+demo_run(struct demo_game *game, const struct action_log *log)
+{
+	/* play until the game ends, returns the number of actions used */
+	int played = 0;
+	while (played < log->count && game->outcome == DEMO_PLAYING)
+	{
+		if (!demo_step(game, &log->actions[played]))
+			break;
+		played++;
+	}
+	return played;
+}
+
+const char *
+demo_outcome(enum DEMO_OUTCOME outcome)
+{
+	switch (outcome)
+	{
+		case DEMO_WON: return "won";
+		case DEMO_LOST: return "lost";
+		case DEMO_QUIT: return "quit";
+		case DEMO_PLAYING:
+		default: return "unfinished";
+	}
+}
+
+int
+demo_seek(struct demo_game *game, const struct action_log *log, int target)
+{
+	/*
+	 * restore the last keyframe at or before target and replay the rest,
+	 * returns the action the game is now at
+	 */
+	const struct demo_keyframe *key = NULL;
+	int low = 0, high = log->keyframecount - 1;
+	if (target < 0)
+		target = 0;
+	if (target > log->count)
+		target = log->count;
+	while (low <= high)
+	{
+		int mid = (low + high) / 2;
+		if (log->keyframes[mid].action <= target)
+		{
+			key = &log->keyframes[mid];
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	int pos = 0;
+	board_reset(game->board);
+	game->x = log->startx;
+	game->y = log->starty;
+	game->outcome = DEMO_PLAYING;
+	if (key)
+	{
+		struct reader reader = { key->planes, key->planes + key->size, 0 };
+		restoreplane(game->board, &reader, 0);
+		restoreplane(game->board, &reader, 1);
+		game->x = key->x;
+		game->y = key->y;
+		pos = key->action;
+		if (mineshown(game->board))
+			game->outcome = DEMO_LOST;
+		else if (board_checkwin(game->board))
+			game->outcome = DEMO_WON;
+	}
+	while (pos < target && game->outcome == DEMO_PLAYING)
+	{
+		if (!demo_step(game, &log->actions[pos]))
+			break;
+		pos++;
+	}
+	return pos;
+}
@@ -0,0 +1,163 @@
+/*
+ * ncsweeper demo files (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEMO_H
+#define DEMO_H
+
+#include "board.h"
+
+/*
+ * version 2 demo layout, all integers are little endian base 128 varints
+ *
+ *	"CSWD" version(1) mines(1) width height minecount
+ *	DEMO_MINES_BITMAP: row-major mine bitmap, bit 0 of each byte first
+ *	DEMO_MINES_SEED: rng type(1) seed(8, little endian), the mines are
+ *		placed by board_placemines() with that generator
+ *	op DEMO_OP_START x y: the cursor before the first action, only
+ *		written when it is not 0 0
+ *	records: op(1) delay_us * run
+ *		op bits 0-2 action type, bits 3-6 run length - 1
+ *		op DEMO_OP_KEYFRAME: action x y hidden-runs flagged-runs
+ *			board state and cursor before the given action, each
+ *			plane is run lengths of alternating 0 and 1 tiles in
+ *			row-major order starting with 0
+ *		op DEMO_OP_INDEX: count (action offset) * count
+ *			file offset of every keyframe, written at close
+ *		op DEMO_OP_END followed by the action count ends the demo
+ *
+ * demos are streamed to disk while recording and flushed every
+ * DEMO_FLUSH_BYTES or DEMO_FLUSH_US of play. the game calls
+ * demo_record_flush() once DEMO_FLUSH_US passes without a key, so nothing
+ * waits in memory while the player is idle. a demo missing its end op
+ * replays up to the last whole action
+ *
+ * version 1 demos are raw struct images written by the old save_demo() and
+ * have no magic, they are still read but never written
+ */
+#define DEMO_MAGIC "CSWD"
+#define DEMO_VERSION 2
+#define DEMO_MINES_BITMAP 0
+#define DEMO_MINES_SEED 1
+#define DEMO_OP_RUN_MAX 16
+#define DEMO_OP_CONTROL 0x80
+#define DEMO_OP_END 0x80
+#define DEMO_OP_KEYFRAME 0x81
+#define DEMO_OP_INDEX 0x82
+#define DEMO_OP_START 0x83
+#define DEMO_KEYFRAME_INTERVAL 64
+#define DEMO_FLUSH_BYTES 4096
+#define DEMO_FLUSH_US 1000000.0
+
+enum DEMO_ACTION_TYPE
+{
+	NONE = 0,
+	GOUP,
+	GODOWN,
+	GOLEFT,
+	GORIGHT,
+	FLAG,
+	REVEAL,
+	QUIT,
+};
+
+/* version 1 file records */
+struct demo_header
+{
+	int width;
+	int height;
+	int mine_count;
+};
+
+struct demo_mine
+{
+	int x;
+	int y;
+};
+
+struct demo_action
+{
+	double action_pre_delay;
+	enum DEMO_ACTION_TYPE type;
+	int start_x;
+	int start_y;
+};
+
+enum DEMO_OUTCOME
+{
+	DEMO_PLAYING = 0,
+	DEMO_WON,
+	DEMO_LOST,
+	DEMO_QUIT,
+};
+
+/* replay state, a demo can be stepped through without any terminal */
+struct demo_game
+{
+	struct board *board;
+	int x, y;
+	enum DEMO_OUTCOME outcome;
+};
+
+/* how a recorded game begins, a seeded board is saved as its seed */
+struct demo_start
+{
+	int seeded;
+	enum RNG_TYPE rng;
+	uint64_t seed;
+	int x, y;	/* the cursor */
+};
+
+/* snapshot to seek from, planes holds the encoded hidden and flagged runs */
+struct demo_keyframe
+{
+	int action;
+	int x, y;
+	size_t size;
+	uint8_t *planes;
+};
+
+/* recorded or loaded actions, one contiguous buffer grown geometrically */
+struct action_log
+{
+	struct demo_action *actions;
+	int count;
+	int capacity;
+	int startx, starty;	/* the cursor before the first action */
+	struct demo_keyframe *keyframes;
+	int keyframecount;
+	int keyframecap;
+};
+
+void actionlog_free(struct action_log *log);
+void actionlog_reset(struct action_log *log);
+int actionlog_reserve(struct action_log *log, int capacity);
+int actionlog_append(struct action_log *log, double delay, enum DEMO_ACTION_TYPE type, int x, int y);
+
+struct demo_recorder;
+
+struct demo_recorder *demo_record_open(const char *filename, const struct board *board, const struct demo_start *start);
+int demo_record_append(struct demo_recorder *recorder, double delay, enum DEMO_ACTION_TYPE type, int x, int y);
+int demo_record_pending(const struct demo_recorder *recorder);
+int demo_record_flush(struct demo_recorder *recorder);
+int demo_record_close(struct demo_recorder *recorder);
+int demo_load(const char *filename, struct board *board, struct action_log *log);
+int demo_step(struct demo_game *game, const struct demo_action *action);
+int demo_run(struct demo_game *game, const struct action_log *log);
+int demo_seek(struct demo_game *game, const struct action_log *log, int target);
+const char *demo_outcome(enum DEMO_OUTCOME outcome);
+
+#endif
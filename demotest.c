@@ -0,0 +1,192 @@
+/*
+ * checks demos survive being cut off at any byte (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "demo.h"
+
+#define DEMOFILE "demotest.tmp"
+#define ACTIONS 300	/* enough for keyframes, an index and a two byte end count */
+
+struct recorded
+{
+	enum DEMO_ACTION_TYPE type[ACTIONS];
+	uint64_t delay[ACTIONS];
+	int count;
+	size_t header;	/* bytes before the first action */
+	size_t size;
+	enum DEMO_OUTCOME outcome;
+	size_t revealed;
+};
+
+int makeboard(struct board *board, uint64_t seed);
+int record(const struct demo_start *start, struct recorded *demo);
+int writecut(const uint8_t *data, size_t size);
+int checkcuts(const char *name, const struct recorded *demo);
+
+int
+makeboard(struct board *board, uint64_t seed)
+{
+	struct rng rng;
+	if (!board_init(board, 16, 16))
+		return 0;
+	rng_seed(&rng, RNG_XOSHIRO, seed);
+	board_placemines(board, 20, &rng);
+	board_countneighbors(board);
+	return 1;
+}
+
+int
+record(const struct demo_start *start, struct recorded *demo)
+{
+	/* random moves, flags and reveals played and recorded as ncsweeper does */
+	struct board board;
+	struct rng rng;
+	struct stat st;
+	if (!makeboard(&board, start->seed))
+		return 0;
+	struct demo_recorder *recorder = demo_record_open(DEMOFILE, &board, start);
+	if (!recorder || stat(DEMOFILE, &st) != 0)
+		return 0;
+	demo->header = st.st_size;
+	struct demo_game game = { &board, start->x, start->y, DEMO_PLAYING };
+	rng_seed(&rng, RNG_PCG, start->seed);
+	for (demo->count = 0; demo->count < ACTIONS; demo->count++)
+	{
+		/* mostly moves so the game lasts, a delay range that needs one to three varint bytes */
+		struct demo_action action = { rng_below(&rng, 40000), GOUP + rng_below(&rng, 4), game.x, game.y };
+		if (rng_below(&rng, 8) == 0)
+			action.type = rng_below(&rng, 2) ? FLAG : REVEAL;
+		if (game.outcome != DEMO_PLAYING)
+			action.type = GOLEFT;
+		demo_step(&game, &action);
+		demo->type[demo->count] = action.type;
+		demo->delay[demo->count] = action.action_pre_delay;
+		demo_record_append(recorder, action.action_pre_delay, action.type, game.x, game.y);
+	}
+	demo->outcome = game.outcome;
+	demo->revealed = board.revealed;
+	board_free(&board);
+	if (demo_record_close(recorder) != ACTIONS || stat(DEMOFILE, &st) != 0)
+		return 0;
+	demo->size = st.st_size;
+	return 1;
+}
+
+int
+writecut(const uint8_t *data, size_t size)
+{
+	FILE *file = fopen(DEMOFILE, "wb");
+	if (!file)
+		return 0;
+	fwrite(data, 1, size, file);
+	return fclose(file) == 0;
+}
+
+int
+checkcuts(const char *name, const struct recorded *demo)
+{
+	/*
+	 * every length from the end of the header up must load, keep a prefix
+	 * of the recorded actions and never lose one a longer cut had
+	 */
+	struct board board = {0};
+	struct action_log log = {0};
+	uint8_t *data = malloc(demo->size);
+	FILE *file = fopen(DEMOFILE, "rb");
+	int ok = data && file && fread(data, 1, demo->size, file) == demo->size, last = 0;
+	if (file)
+		fclose(file);
+	for (size_t cut = demo->header; ok && cut <= demo->size; cut++)
+	{
+		actionlog_reset(&log);
+		if (!writecut(data, cut) || demo_load(DEMOFILE, &board, &log) != 1)
+		{
+			printf("%s: cut to %zu of %zu bytes does not load\n", name, cut, demo->size);
+			ok = 0;
+			break;
+		}
+		if (log.count < last || log.count > demo->count)
+		{
+			printf("%s: cut to %zu bytes has %d actions, %d before\n", name, cut, log.count, last);
+			ok = 0;
+		}
+		for (int i = 0; ok && i < log.count; i++)
+		{
+			if (log.actions[i].type != demo->type[i] || log.actions[i].action_pre_delay != demo->delay[i])
+			{
+				printf("%s: cut to %zu bytes changes action %d\n", name, cut, i);
+				ok = 0;
+			}
+		}
+		last = log.count;
+		if (ok && cut == demo->size)
+		{
+			/* the whole demo replays to the same end, played through and seeked to */
+			board_countneighbors(&board);
+			struct demo_game game = { &board, log.startx, log.starty, DEMO_PLAYING };
+			demo_run(&game, &log);
+			enum DEMO_OUTCOME outcome = game.outcome;
+			size_t revealed = board.revealed;
+			demo_seek(&game, &log, log.count);
+			if (log.count != demo->count || outcome != demo->outcome || revealed != demo->revealed ||
+					game.outcome != demo->outcome || board.revealed != demo->revealed)
+			{
+				printf("%s: the whole demo does not replay as recorded\n", name);
+				ok = 0;
+			}
+		}
+		board_free(&board);
+	}
+	actionlog_free(&log);
+	free(data);
+	return ok;
+}
+
+int
+main()
+{
+	/* a bitmap board from 0 0, then a seeded one from elsewhere */
+	struct demo_start starts[] = {
+		{ 0, RNG_XOSHIRO, 7, 0, 0 },
+		{ 1, RNG_XOSHIRO, 8, 5, 9 },
+	};
+	const char *names[] = { "bitmap demo", "seeded demo" };
+	int ok = 1;
+	for (size_t s = 0; s < sizeof starts / sizeof starts[0] && ok; s++)
+	{
+		struct recorded demo;
+		if (!record(&starts[s], &demo))
+		{
+			printf("%s: cannot record\n", names[s]);
+			ok = 0;
+		}
+		else if (checkcuts(names[s], &demo))
+		{
+			printf("%s: every cut of %zu bytes loads\n", names[s], demo.size);
+		}
+		else
+		{
+			ok = 0;
+		}
+	}
+	remove(DEMOFILE);
+	return !ok;
+}
@@ -0,0 +1,213 @@
+/*
+ * batch demo verifier for ncsweeper (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "demo.h"
+
+#define MAXTHREADS 256
+
+struct files
+{
+	char **paths;
+	int count;
+	int capacity;
+};
+
+/* shared between workers, everything else a worker touches is its own */
+struct batch
+{
+	struct files files;
+	int next;
+	int bad;
+	long long actions;
+	pthread_mutex_t lock;
+} batch = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+int addfile(struct files *files, const char *path);
+int adddir(struct files *files, const char *dir);
+int cmppath(const void *a, const void *b);
+void verify(const char *path, struct board *board, struct action_log *log);
+void *worker(void *arg);
+
+int
+addfile(struct files *files, const char *path)
+{
+	if (files->count == files->capacity)
+	{
+		int capacity = files->capacity ? files->capacity * 2 : 64;
+		char **paths = realloc(files->paths, sizeof(char *) * capacity);
+		if (!paths)
+			return 0;
+		files->paths = paths;
+		files->capacity = capacity;
+	}
+	files->paths[files->count] = strdup(path);
+	return files->paths[files->count++] != NULL;
+}
+
+int
+cmppath(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+int
+adddir(struct files *files, const char *dir)
+{
+	/* every .dem file directly inside dir, in name order */
+	DIR *d = opendir(dir);
+	if (!d)
+		return 0;
+	int first = files->count;
+	struct dirent *entry;
+	char path[4096];
+	while ((entry = readdir(d)))
+	{
+		size_t len = strlen(entry->d_name);
+		if (len < 4 || strcmp(entry->d_name + len - 4, ".dem") != 0)
+			continue;
+		snprintf(path, sizeof path, "%s/%s", dir, entry->d_name);
+		if (!addfile(files, path))
+		{
+			closedir(d);
+			return 0;
+		}
+	}
+	closedir(d);
+	qsort(files->paths + first, files->count - first, sizeof(char *), cmppath);
+	return 1;
+}
+
+void
+verify(const char *path, struct board *board, struct action_log *log)
+{
+	char line[4096 + 128];
+	actionlog_reset(log);
+	int status = demo_load(path, board, log);
+	if (status <= 0)
+	{
+		pthread_mutex_lock(&batch.lock);
+		batch.bad++;
+		printf("%s: %s\n", path, status < 0 ? "unreadable" : "corrupt");
+		pthread_mutex_unlock(&batch.lock);
+		return;
+	}
+	board_countneighbors(board);
+	struct demo_game game = { board, log->startx, log->starty, DEMO_PLAYING };
+	int played = demo_run(&game, log);
+	snprintf(line, sizeof line, "%s: %s, %d/%d actions, %zu tiles revealed\n",
+			path, demo_outcome(game.outcome), played, log->count, board->revealed);
+	board_free(board);
+
+	pthread_mutex_lock(&batch.lock);
+	batch.actions += played;
+	fputs(line, stdout);
+	pthread_mutex_unlock(&batch.lock);
+}
+
+void *
+worker(void *arg)
+{
+	/* each worker keeps one board and one action buffer for all its demos */
+	struct board board = {0};
+	struct action_log log = {0};
+	(void)arg;
+	for (;;)
+	{
+		pthread_mutex_lock(&batch.lock);
+		int next = batch.next++;
+		pthread_mutex_unlock(&batch.lock);
+		if (next >= batch.files.count)
+			break;
+		verify(batch.files.paths[next], &board, &log);
+	}
+	actionlog_free(&log);
+	return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int arg = 1;
+	if (argc > 2 && strcmp(argv[1], "-j") == 0)
+	{
+		threads = atoi(argv[2]);
+		arg = 3;
+	}
+	if (arg >= argc || threads < 1)
+	{
+		printf("usage: %s [-j threads] demo.dem|directory ...\n", argv[0]);
+		return 1;
+	}
+	if (threads > MAXTHREADS)
+		threads = MAXTHREADS;
+
+	for (; arg < argc; arg++)
+	{
+		struct stat st;
+		int ok;
+		if (stat(argv[arg], &st) == 0 && S_ISDIR(st.st_mode))
+			ok = adddir(&batch.files, argv[arg]);
+		else
+			ok = addfile(&batch.files, argv[arg]);
+		if (!ok)
+		{
+			printf("cannot read %s\n", argv[arg]);
+			return 1;
+		}
+	}
+	if (threads > batch.files.count)
+		threads = batch.files.count ? batch.files.count : 1;
+
+	struct timespec begin, end;
+	pthread_t pool[MAXTHREADS];
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (long t = 0; t < threads; t++)
+	{
+		if (pthread_create(&pool[t], NULL, worker, NULL) != 0)
+		{
+			/* run with however many workers did start */
+			threads = t;
+			break;
+		}
+	}
+	if (threads == 0)
+		worker(NULL);
+	for (long t = 0; t < threads; t++)
+		pthread_join(pool[t], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	if (seconds <= 0)
+		seconds = 1e-9;
+	printf("%d demos (%d bad) on %ld threads, %lld actions in %.3fs, %.0f demos/s, %.0f actions/s\n",
+			batch.files.count, batch.bad, threads ? threads : 1, batch.actions, seconds,
+			batch.files.count / seconds, batch.actions / seconds);
+	for (int i = 0; i < batch.files.count; i++)
+		free(batch.files.paths[i]);
+	free(batch.files.paths);
+	return batch.bad != 0;
+}
@@ -0,0 +1,334 @@
+/*
+ * unbounded minesweeper board (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "field.h"
+#include "rng.h"
+
+static int chunkof(int v);
+static size_t slotof(const struct field *field, int cx, int cy);
+static struct field_chunk *findchunk(struct field *field, int cx, int cy);
+static int growslots(struct field *field);
+static int edgemine(const struct field *field, int64_t x, int64_t y);
+static uint64_t minerow(const struct field *field, int x, int64_t y);
+static void countchunk(const struct field *field, struct field_chunk *chunk);
+static struct field_chunk *getchunk(struct field *field, int cx, int cy);
+static int queuetile(struct field *field, int x, int y);
+
+static int
+chunkof(int v)
+{
+	/* rounds towards negative infinity so chunk -1 holds tiles -64 to -1 */
+	return v >= 0 ? v / FIELD_CHUNK : -(-(v + 1) / FIELD_CHUNK) - 1;
+}
+
+static size_t
+slotof(const struct field *field, int cx, int cy)
+{
+	uint64_t key = ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+	return (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (field->slotcount - 1);
+}
+
+static struct field_chunk *
+findchunk(struct field *field, int cx, int cy)
+{
+	struct field_chunk *chunk = field->last;
+	if (chunk && chunk->cx == cx && chunk->cy == cy)
+		return chunk;
+	for (size_t s = slotof(field, cx, cy); (chunk = field->slots[s]); s = (s + 1) & (field->slotcount - 1))
+	{
+		if (chunk->cx == cx && chunk->cy == cy)
+		{
+			field->last = chunk;
+			return chunk;
+		}
+	}
+	return NULL;
+}
+
+static int
+growslots(struct field *field)
+{
+	struct field_chunk **old = field->slots;
+	size_t oldcount = field->slotcount;
+	field->slotcount *= 2;
+	field->slots = calloc(field->slotcount, sizeof(struct field_chunk *));
+	if (!field->slots)
+	{
+		field->slots = old;
+		field->slotcount = oldcount;
+		return 0;
+	}
+	for (size_t i = 0; i < oldcount; i++)
+	{
+		struct field_chunk *chunk = old[i];
+		if (!chunk)
+			continue;
+		size_t s = slotof(field, chunk->cx, chunk->cy);
+		while (field->slots[s])
+			s = (s + 1) & (field->slotcount - 1);
+		field->slots[s] = chunk;
+	}
+	free(old);
+	return 1;
+}
+
+int
+field_init(struct field *field, uint64_t seed, int density)
+{
+	/* density is the percentage of tiles that are mines */
+	memset(field, 0, sizeof *field);
+	if (density <= 0 || density >= 100)
+		return 0;
+	field->seed = seed;
+	field->threshold = (uint64_t)(density / 100.0 * 18446744073709551616.0);
+	field->slotcount = 64;
+	field->slots = calloc(field->slotcount, sizeof(struct field_chunk *));
+	if (!field->slots)
+		return 0;
+	return 1;
+}
+
+void
+field_free(struct field *field)
+{
+	for (size_t i = 0; i < field->slotcount; i++)
+		free(field->slots[i]);
+	free(field->slots);
+	free(field->queue);
+	memset(field, 0, sizeof *field);
+}
+
+int
+field_mineat(const struct field *field, int x, int y)
+{
+	uint64_t counter = ((uint64_t)(uint32_t)y << 32) | (uint32_t)x;
+	return rng_hash(field->seed, counter) < field->threshold;
+}
+
+static int
+edgemine(const struct field *field, int64_t x, int64_t y)
+{
+	/* a neighbor past the ends of int is off the field, reveals never go there */
+	if (x < INT_MIN || x > INT_MAX || y < INT_MIN || y > INT_MAX)
+		return 0;
+	return field_mineat(field, x, y);
+}
+
+static uint64_t
+minerow(const struct field *field, int x, int64_t y)
+{
+	/* mines of the 64 tiles starting at x, y, bit 0 first */
+	uint64_t row = 0;
+	if (y < INT_MIN || y > INT_MAX)
+		return 0;
+	for (int i = 0; i < FIELD_CHUNK; i++)
+		row |= (uint64_t)field_mineat(field, x + i, y) << i;
+	return row;
+}
+
+static void
+countchunk(const struct field *field, struct field_chunk *chunk)
+{
+	/*
+	 * rows above and below and the columns either side come from the hash,
+	 * neighboring chunks may not exist yet and would give the same answer
+	 */
+	int64_t x0 = (int64_t)chunk->cx * FIELD_CHUNK, y0 = (int64_t)chunk->cy * FIELD_CHUNK;
+	uint64_t rows[FIELD_CHUNK + 2];
+	uint8_t left[FIELD_CHUNK + 2], right[FIELD_CHUNK + 2];
+	for (int r = 0; r < FIELD_CHUNK + 2; r++)
+	{
+		int64_t y = y0 + r - 1;
+		if (r == 0 || r == FIELD_CHUNK + 1)
+			rows[r] = minerow(field, x0, y);
+		else
+			rows[r] = chunk->mine[r - 1];
+		left[r] = edgemine(field, x0 - 1, y);
+		right[r] = edgemine(field, x0 + FIELD_CHUNK, y);
+	}
+	memset(chunk->counts, 0, sizeof chunk->counts);
+	for (int y = 0; y < FIELD_CHUNK; y++)
+	{
+		for (int x = 0; x < FIELD_CHUNK; x++)
+		{
+			int count = 0;
+			for (int r = y; r < y + 3; r++)
+			{
+				if (x > 0)
+					count += (rows[r] >> (x - 1)) & 1;
+				else
+					count += left[r];
+				count += (rows[r] >> x) & 1;
+				if (x < FIELD_CHUNK - 1)
+					count += (rows[r] >> (x + 1)) & 1;
+				else
+					count += right[r];
+			}
+			count -= (chunk->mine[y] >> x) & 1;
+			int i = y * FIELD_CHUNK + x;
+			chunk->counts[i >> 1] |= count << ((i & 1) << 2);
+		}
+	}
+}
+
+static struct field_chunk *
+getchunk(struct field *field, int cx, int cy)
+{
+	/* the chunk holding these coordinates, generated the first time it is touched */
+	struct field_chunk *chunk = findchunk(field, cx, cy);
+	if (chunk)
+		return chunk;
+	if ((field->chunkcount + 1) * 2 > field->slotcount && !growslots(field))
+		return NULL;
+	chunk = malloc(sizeof *chunk);
+	if (!chunk)
+		return NULL;
+	chunk->cx = cx;
+	chunk->cy = cy;
+	for (int r = 0; r < FIELD_CHUNK; r++)
+	{
+		chunk->mine[r] = minerow(field, cx * FIELD_CHUNK, cy * FIELD_CHUNK + r);
+		chunk->hidden[r] = ~(uint64_t)0;
+		chunk->flagged[r] = 0;
+	}
+	countchunk(field, chunk);
+
+	size_t s = slotof(field, cx, cy);
+	while (field->slots[s])
+		s = (s + 1) & (field->slotcount - 1);
+	field->slots[s] = chunk;
+	field->chunkcount++;
+	field->last = chunk;
+	return chunk;
+}
+
+enum STATE
+field_state(struct field *field, int x, int y)
+{
+	struct field_chunk *chunk = findchunk(field, chunkof(x), chunkof(y));
+	if (!chunk)
+		return HIDDEN | (field_mineat(field, x, y) ? MINE : 0);
+	int lx = x - chunk->cx * FIELD_CHUNK, ly = y - chunk->cy * FIELD_CHUNK;
+	return (((chunk->hidden[ly] >> lx) & 1) ? HIDDEN : 0) |
+		(((chunk->mine[ly] >> lx) & 1) ? MINE : 0) |
+		(((chunk->flagged[ly] >> lx) & 1) ? FLAGGED : 0);
+}
+
+int
+field_neighbormines(struct field *field, int x, int y)
+{
+	struct field_chunk *chunk = findchunk(field, chunkof(x), chunkof(y));
+	if (!chunk)
+	{
+		int count = 0;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if (dx || dy)
+					count += edgemine(field, (int64_t)x + dx, (int64_t)y + dy);
+			}
+		}
+		return count;
+	}
+	int i = (y - chunk->cy * FIELD_CHUNK) * FIELD_CHUNK + (x - chunk->cx * FIELD_CHUNK);
+	return (chunk->counts[i >> 1] >> ((i & 1) << 2)) & 0xf;
+}
+
+void
+field_toggleflag(struct field *field, int x, int y)
+{
+	struct field_chunk *chunk = getchunk(field, chunkof(x), chunkof(y));
+	if (!chunk)
+		return;
+	int lx = x - chunk->cx * FIELD_CHUNK, ly = y - chunk->cy * FIELD_CHUNK;
+	chunk->flagged[ly] ^= (uint64_t)1 << lx;
+}
+
+static int
+queuetile(struct field *field, int x, int y)
+{
+	if (field->queuecap && field->queuecount == field->queuecap && field->queuehead >= field->queuecount / 2)
+	{
+		/* drop the tiles already taken off the front rather than grow */
+		field->queuecount -= field->queuehead;
+		memmove(field->queue, field->queue + field->queuehead, field->queuecount * sizeof(struct field_tile));
+		field->queuehead = 0;
+	}
+	if (field->queuecount == field->queuecap)
+	{
+		size_t cap = field->queuecap ? field->queuecap * 2 : 64;
+		struct field_tile *queue = realloc(field->queue, cap * sizeof(struct field_tile));
+		if (!queue)
+			return 0;
+		field->queue = queue;
+		field->queuecap = cap;
+	}
+	field->queue[field->queuecount].x = x;
+	field->queue[field->queuecount].y = y;
+	field->queuecount++;
+	return 1;
+}
+
+int
+field_reveal(struct field *field, int x, int y, size_t *opened)
+{
+	size_t count = 0;
+	if (opened)
+		*opened = 0;
+	/* breadth first so a flood cut short is a compact patch over few chunks */
+	field->queuehead = 0;
+	field->queuecount = 0;
+	queuetile(field, x, y);
+	while (field->queuehead < field->queuecount && count < FIELD_FLOOD_MAX)
+	{
+		struct field_tile tile = field->queue[field->queuehead++];
+		struct field_chunk *chunk = getchunk(field, chunkof(tile.x), chunkof(tile.y));
+		if (!chunk)
+			break;
+		int lx = tile.x - chunk->cx * FIELD_CHUNK, ly = tile.y - chunk->cy * FIELD_CHUNK;
+		uint64_t bit = (uint64_t)1 << lx;
+		if (!(chunk->hidden[ly] & bit))
+			continue;
+		chunk->hidden[ly] &= ~bit;
+		if (chunk->mine[ly] & bit)
+			return 1;
+		count++;
+		int i = ly * FIELD_CHUNK + lx;
+		if ((chunk->counts[i >> 1] >> ((i & 1) << 2)) & 0xf)
+			continue;
+		/* a zero tile opens its neighbors, up to the ends of int */
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				if ((dx < 0 && tile.x == INT_MIN) || (dx > 0 && tile.x == INT_MAX) ||
+						(dy < 0 && tile.y == INT_MIN) || (dy > 0 && tile.y == INT_MAX))
+					continue;
+				if (dx || dy)
+					queuetile(field, tile.x + dx, tile.y + dy);
+			}
+		}
+	}
+	field->revealed += count;
+	if (opened)
+		*opened = count;
+	return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * unbounded minesweeper board (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+
+#define FIELD_CHUNK_BITS 6
+#define FIELD_CHUNK (1 << FIELD_CHUNK_BITS)	/* tiles along a chunk side, one word per row */
+#define FIELD_FLOOD_MAX (1 << 18)	/* most tiles a single reveal opens */
+
+/*
+ * a field has no edges. whether a tile is a mine is a hash of the seed and
+ * its coordinates, so any tile can be asked about without storing anything.
+ * tiles only need memory once they are revealed or flagged, which happens a
+ * chunk at a time, chunks are kept in an open addressed table keyed by chunk
+ * coordinates. a tile in a chunk that was never touched is hidden.
+ *
+ * below roughly 10% mines the zero tiles can join up without end, so a
+ * reveal stops after FIELD_FLOOD_MAX tiles and leaves the rest hidden
+ */
+struct field_chunk
+{
+	int cx, cy;
+	uint64_t mine[FIELD_CHUNK];
+	uint64_t hidden[FIELD_CHUNK];
+	uint64_t flagged[FIELD_CHUNK];
+	uint8_t counts[FIELD_CHUNK * FIELD_CHUNK / 2];
+};
+
+struct field_tile
+{
+	int x, y;
+};
+
+struct field
+{
+	uint64_t seed;
+	uint64_t threshold;	/* tiles hashing below this are mines */
+	struct field_chunk **slots;
+	size_t slotcount;	/* a power of two, kept at most half full */
+	size_t chunkcount;
+	struct field_chunk *last;	/* most recently used chunk */
+	size_t revealed;
+	struct field_tile *queue;
+	size_t queuehead;
+	size_t queuecount;
+	size_t queuecap;
+};
+
+int field_init(struct field *field, uint64_t seed, int density);
+void field_free(struct field *field);
+int field_mineat(const struct field *field, int x, int y);
+enum STATE field_state(struct field *field, int x, int y);
+int field_neighbormines(struct field *field, int x, int y);
+void field_toggleflag(struct field *field, int x, int y);
+int field_reveal(struct field *field, int x, int y, size_t *opened);
+
+#endif
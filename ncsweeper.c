@@ -18,9 +18,15 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <ncurses.h>
 #include <string.h>
+#include <limits.h>
+#include "board.h"
+#include "field.h"
+#include "demo.h"
+#include "noguess.h"
 
 #define WIDTH 15
 #define HEIGHT 15
@@ -30,70 +36,47 @@
 #define UP 1
 #define LEFT 2
 #define RIGHT 3
-
-enum DEMO_ACTION_TYPE
-{
-	NONE = 0,
-	GOUP,
-	GODOWN,
-	GOLEFT,
-	GORIGHT,
-	FLAG,
-	REVEAL,
-	QUIT,
-};
-
-struct demo_header
-{
-	int width;
-	int height;
-	int mine_count;
-};
-
-struct demo_mine
-{
-	int x;
-	int y;
-};
-
-struct demo_action
-{
-	double action_pre_delay;
-	enum DEMO_ACTION_TYPE type;
-	int start_x;
-	int start_y;
-};
-
-struct action_node
-{
-	struct demo_action *action;
-	struct action_node *next;
-} *action_head = NULL;
-
-enum STATE
-{
-	HIDDEN 	= 1 << 0,
-	MINE	= 1 << 1,
-	FLAGGED	= 1 << 2,
-};
+#define FRAME_NS 16666667L	/* longest a catch up runs before drawing */
+#define POLL_NS 10000000L	/* key polling interval while waiting */
+#define SPEEDCOUNT 10
+
+struct action_log action_log = {0};
+struct demo_recorder *recorder = NULL;
+struct demo_game replay = {0};
+int current_action = 0;
+int paused = 0;
+
+/* playback speeds, 0 plays every action as soon as it can be drawn */
+double speeds[SPEEDCOUNT] = {0.25, 0.5, 1, 2, 4, 10, 25, 50, 100, 0};
+int speed = 2;
+/* actions are due at epoch plus the recorded delays since, scaled by speed */
+struct timespec epoch;
+double since_epoch = 0;
 
 struct game
 {
 	int width;
 	int height;
 	int minecount;
-	int action_count;
 	int is_demo;
 	int is_recording;
+	int is_verify;
+	int is_infinite;
+	int is_noguess;
+	int is_regions;
+	int is_seeded;
+	int density;
+	enum RNG_TYPE rng;
+	unsigned long long seed;
 	char demo_filename[512];
+	char noguess_filename[512];
 } game;
 
-struct tile
-{
-	enum STATE state;
-	int x, y;
-	int neighbormines;
-} *board = NULL;
+/* the board to build when playing without guesses, found before curses starts */
+struct noguess_board noguess;
+
+struct board board;
+struct field field;
 
 struct cursor
 {
@@ -101,93 +84,62 @@ struct cursor
 	int y;
 } cursor = {0};
 
+/* the part of the board on screen, all of it unless the terminal is too small */
+struct view
+{
+	int x, y;	/* top left tile */
+	int width, height;
+} view = {0};
+
 WINDOW *window;
 int exitgame = 0;
+int fullredraw = 1;
 
 void draw();
+void drawtile(int x, int y);
+void sizeview();
+void scrollview();
+int gettile(int x, int y, struct tile *tile);
 int canmove(int dir);
 int generateboard();
 void drawboard();
-int reveal(int x, int y);
-void revealmines();
-struct tile *getneighbors(struct tile *tile, struct tile **neighbors);
-struct tile *gettileat(int x, int y);
-int checkwin();
+int waitkey();
 enum DEMO_ACTION_TYPE input();
-void free_action_list();
-struct action_node *generate_action_node(double delay, enum DEMO_ACTION_TYPE type, int x, int y);
-int append_action_node(struct action_node *node);
-void save_demo();
+int start_recording();
+void stop_recording();
 int load_demo();
-struct action_node *play_demo_action(struct action_node *current_action);
-
-struct tile *getneighbors(struct tile *tile, struct tile **neighbors)
-{
-	int badup = 0, baddown = 0, badleft = 0, badright = 0;
-	if (tile->x-1<0) badleft = 1;
-	if (tile->x+1>game.width-1) badright = 1;
-
-	if (tile->y-1<0) badup = 1;
-	if (tile->y+1>game.height-1) baddown = 1;
-
-	if (!badleft && !badup) neighbors[0] = gettileat(tile->x-1, tile->y-1);
-	if (!badup) neighbors[1] = gettileat(tile->x, tile->y-1);
-	if (!badright && !badup) neighbors[2] = gettileat(tile->x+1, tile->y-1);
-
-	if (!badleft) neighbors[3] = gettileat(tile->x-1, tile->y);
-	if (!badright) neighbors[4] = gettileat(tile->x+1, tile->y);
-
-	if (!badleft && !baddown) neighbors[5] = gettileat(tile->x-1, tile->y+1);
-	if (!baddown) neighbors[6] = gettileat(tile->x, tile->y+1);
-	if (!badright && !baddown) neighbors[7] = gettileat(tile->x+1, tile->y+1);
-
-	return *neighbors;
-}
+int play_demo_action(struct demo_action *action);
+void seek_demo(int target);
+void demo_controls(int ch);
+void resync_demo();
+void play_demo();
+int verify_demo();
 
 int
-checkwin()
+generateboard()
 {
-
-	int allowedmines = game.minecount;
-	int safetiles = (game.height * game.width) - game.minecount;
-	int correctflags = 0;
-	int correcttiles = 0;
-
-	for (int x = 0; x < game.width; x++)
+	if (game.is_infinite)
 	{
-		for (int y = 0; y < game.height; y++)
-		{
-			struct tile *tile = gettileat(x, y);
-			if (tile->state & MINE && tile->state & FLAGGED)
-				correctflags++;
-			else if (!(tile->state & MINE) && !(tile->state & HIDDEN))
-				correcttiles++;
-		}
+		if (!field_init(&field, game.seed, game.density))
+			return 0;
+		/* the window is the size of the terminal and scrolls over the field */
+		window = newwin(1, 1, 1, 8);
+		sizeview();
+		return 1;
 	}
-
-	return (correctflags == allowedmines) || (correcttiles == safetiles);
-}
-
-int
-generateboard()
-{
-	srand(time(NULL));
-	if (!game.is_demo)
+	if (game.is_noguess)
 	{
-		board = malloc(sizeof (struct tile) * (game.width * game.height));
+		if (!noguess_build(&board, &noguess))
+			return 0;
+	}
+	else if (!game.is_demo)
+	{
+		struct rng rng;
+		rng_seed(&rng, game.rng, game.seed);
+		if (!board_init(&board, game.width, game.height))
+			return 0;
 		/* place mines */
-		int mx, my;
-		for (int x = 0; x < game.minecount; x++)
-		{
-place_mine:
-			mx = rand() % game.width;
-			my = rand() % game.height;
-			/*ensure our tile is not already a mine */
-			if (gettileat(mx, my)->state & MINE)
-				goto place_mine;
-			struct tile *tile = gettileat(mx, my);
-			tile->state |= MINE;
-		}
+		board_placemines(&board, game.minecount, &rng);
 	}
 	else
 	{
@@ -199,80 +151,77 @@ place_mine:
 	}
 
 	/* create window here because if we're playing a demo we need the width/height */
-	window = newwin(game.height+TILEGAP, (game.width*TILEGAP)+1, 1, 8);
-	/* figure out neighbors */
-	for (int y = 0; y < game.height; y++)
-	{
-		for (int x = 0; x < game.width; x++)
-		{
-			struct tile *tile = gettileat(x, y);
-			tile->x = x;
-			tile->y = y;
-			tile->state |= HIDDEN;
-			struct tile *neighbors[8] = {NULL};
-			getneighbors(tile, neighbors);
-			tile->neighbormines = 0;
-			for (int i = 0; i < 8; i++)
-				if (neighbors[i] != NULL && neighbors[i]->state & MINE)
-					tile->neighbormines += 1;
-		}
-	}
+	window = newwin(1, 1, 1, 8);
+	sizeview();
+	/* figure out neighbors, noguess_build() does its own */
+	if (!game.is_noguess)
+		board_countneighbors(&board);
+	/*
+	 * zero regions cost a pass over the whole board before the first move,
+	 * reveals flood fill without them and preset sizes use their kernel
+	 */
+	if (game.is_regions && !board.preset)
+		board_labelregions(&board);
 	return 1;
 }
 
-struct tile *
-gettileat(int x, int y)
+void
+sizeview()
 {
-	if (x < 0 || x > game.width-1 || y < 0 || y > game.height-1 || board == NULL)
-		return NULL;
-	/* the board is single dimensional, so we map it as 2d */
-	return &board[game.height*x+y];
+	/* as much of the board as fits above the help text, an infinite field fills it */
+	view.height = LINES - 11 > 1 ? LINES - 11 : 1;
+	view.width = (COLS - 9) / TILEGAP > 1 ? (COLS - 9) / TILEGAP : 1;
+	if (!game.is_infinite && view.height > game.height)
+		view.height = game.height;
+	if (!game.is_infinite && view.width > game.width)
+		view.width = game.width;
+	wresize(window, view.height+TILEGAP, (view.width*TILEGAP)+1);
+	view.x = cursor.x - view.width / 2;
+	view.y = cursor.y - view.height / 2;
+	scrollview();
 }
 
-int
-reveal(int x, int y)
+void
+scrollview()
 {
-	struct tile *tile = gettileat(x, y);
-	tile->state &= ~HIDDEN;
-	if (tile->state & MINE)
-		return 1;
-	if (tile->neighbormines == 0)
-	{
-		tile->state &= ~HIDDEN;
-		struct tile *neighbors[8] = {NULL};
-		getneighbors(tile, neighbors);
-		for (int nc = 0; nc < 8; nc++)
-		{
-			struct tile *neighbor = neighbors[nc];
-			if (neighbor != NULL && !(neighbor->state & MINE) && neighbor->state & HIDDEN)
-			{
-				neighbor->state &= ~HIDDEN;
-				if (neighbor->neighbormines == 0)
-				{
-					reveal(neighbor->x, neighbor->y);
-				}
-			}
-		}
-	}
-	return 0;
+	/* recentre on the cursor once it walks off screen, without passing the board edge */
+	if (cursor.x < view.x || cursor.x >= view.x + view.width)
+		view.x = cursor.x - view.width / 2;
+	if (cursor.y < view.y || cursor.y >= view.y + view.height)
+		view.y = cursor.y - view.height / 2;
+	if (game.is_infinite)
+		return;
+	if (view.x > game.width - view.width)
+		view.x = game.width - view.width;
+	if (view.y > game.height - view.height)
+		view.y = game.height - view.height;
+	if (view.x < 0)
+		view.x = 0;
+	if (view.y < 0)
+		view.y = 0;
 }
 
-void
-revealmines()
-{	for (int y = 0; y < game.height; y++)
-	{
-		for (int x = 0; x < game.width; x++)
-		{
-			if (gettileat(x, y)->state & MINE)
-				reveal(x, y);
-		}
-	}
+int
+gettile(int x, int y, struct tile *tile)
+{
+	if (!game.is_infinite)
+		return board_gettileat(&board, x, y, tile);
+	tile->state = field_state(&field, x, y);
+	tile->neighbormines = field_neighbormines(&field, x, y);
+	return 1;
 }
 
 int
 canmove(int dir)
 {
-	/* check if cursor inside game region */
+	/* check if cursor inside game region, a field only ends where int does */
+	if (game.is_infinite)
+	{
+		if (dir == LEFT) return cursor.x > INT_MIN;
+		else if (dir == RIGHT) return cursor.x < INT_MAX;
+		else if (dir == UP) return cursor.y > INT_MIN;
+		return cursor.y < INT_MAX;
+	}
 	if (dir == LEFT && cursor.x <= 0) return 0;
 	else if (dir == RIGHT && cursor.x >= game.width-1) return 0;
 	else if (dir == UP && cursor.y <= 0) return 0;
@@ -280,48 +229,142 @@ canmove(int dir)
 	return 1;
 }
 
+void
+drawtile(int x, int y)
+{
+	struct tile tile;
+	gettile(x, y, &tile);
+	char neighbormines = (char)tile.neighbormines+'0';
+	if (neighbormines == '0')
+		neighbormines = ' ';
+	x -= view.x;
+	y -= view.y;
+	if (tile.state & FLAGGED)
+		mvwaddch(window, y+1, (x*TILEGAP)+1, 'F');
+	else if (tile.state & HIDDEN)
+		mvwaddch(window, y+1, (x*TILEGAP)+1, '.');
+	else
+		mvwaddch(window, y+1, (x*TILEGAP)+1, (tile.state & MINE) ? 'M' : neighbormines);
+}
+
 void
 draw()
 {
-	wclear(window);
-	box(window, 0, 0);
-	if (!exitgame)
+	/*
+	 * only tiles the board reports as changed are repainted, the whole
+	 * screen is redrawn at startup, on resize, on scrolling and when the
+	 * game ends. an infinite field keeps no change list so every tile in
+	 * the window is repainted. either way a frame costs at most the tiles
+	 * on screen, however big the board
+	 */
+	struct view old = view;
+	if (fullredraw)
+		sizeview();
+	scrollview();
+	if (old.x != view.x || old.y != view.y)
+		fullredraw = 1;
+	if (fullredraw || board.changesdropped)
 	{
-		mvprintw(game.height+3, 0, "The aim of the game is to reveal all non-mine tiles or flag every mine tile");
-		mvprintw(game.height+5, 0, "hjkl/wasd to move cursor\nspace to reveal tile\nf to flag tile");
+		werase(window);
+		box(window, 0, 0);
+		if (!exitgame)
+		{
+			erase();
+			mvprintw(view.height+3, 0, "The aim of the game is to reveal all non-mine tiles or flag every mine tile");
+			if (game.is_demo)
+				mvprintw(view.height+5, 0, "space/p to pause, n/b to step forward/back\n[ and ] to seek, r to rewind\n- and + to change speed, q to quit");
+			else
+				mvprintw(view.height+5, 0, "hjkl/wasd to move cursor\nspace to reveal tile\nf to flag tile");
+			if (game.is_noguess)
+				mvprintw(view.height+9, 0, "seed: %llu, no guessing needed from %d %d", game.seed, noguess.x, noguess.y);
+			else if (!game.is_demo && game.rng != RNG_XOSHIRO)
+				mvprintw(view.height+9, 0, "seed: %llu, rng: %s", game.seed, rng_name(game.rng));
+			else if (!game.is_demo)
+				mvprintw(view.height+9, 0, "seed: %llu", game.seed);
+		}
+		else
+		{
+			erase();
+		}
+		for (int y = 0; y < view.height; y++)
+		{
+			for (int x = 0; x < view.width; x++)
+				drawtile(view.x + x, view.y + y);
+		}
+		fullredraw = 0;
 	}
-	else
+	else if (game.is_infinite || board.changecount > (size_t)view.width * view.height)
 	{
-		clear();
+		for (int y = 0; y < view.height; y++)
+		{
+			for (int x = 0; x < view.width; x++)
+				drawtile(view.x + x, view.y + y);
+		}
 	}
-	for (int x = 0; x < game.width; x++)
+	else
 	{
-		for (int y = 0; y < game.height; y++)
+		for (size_t c = 0; c < board.changecount; c++)
 		{
-			struct tile *tile = gettileat(x, y);
-			char neighbormines = (char)tile->neighbormines+'0';
-			if (neighbormines == '0')
-				neighbormines = ' ';
-			if (tile->state & FLAGGED)
-				mvwprintw(window, y+1, (x*TILEGAP)+1, "F");
-			else if (tile->state & HIDDEN)
-				mvwprintw(window, y+1, (x*TILEGAP)+1, ".");
-
-			else
-				mvwprintw(window, y+1, (x*TILEGAP)+1, "%c", (tile->state & MINE) ? 'M' : neighbormines);
+			int x, y;
+			board_coords(&board, board.changes[c], &x, &y);
+			if (x >= view.x && x < view.x + view.width && y >= view.y && y < view.y + view.height)
+				drawtile(x, y);
 		}
 	}
-	wmove(window, cursor.y+1, (cursor.x*TILEGAP)+1);
-	refresh();
-	wrefresh(window);
+	board_clearchanges(&board);
+	if (game.is_demo && !exitgame)
+	{
+		if (speeds[speed] > 0)
+			mvprintw(view.height+9, 0, "action %d/%d at %gx%s", current_action, action_log.count, speeds[speed], paused ? " paused" : "");
+		else
+			mvprintw(view.height+9, 0, "action %d/%d instant%s", current_action, action_log.count, paused ? " paused" : "");
+		clrtoeol();
+	}
+	if (!game.is_infinite && !exitgame && (view.width < game.width || view.height < game.height))
+	{
+		mvprintw(view.height+10, 0, "showing %d-%d, %d-%d of %dx%d", view.x, view.x+view.width-1,
+				view.y, view.y+view.height-1, game.width, game.height);
+		clrtoeol();
+	}
+	if (game.is_infinite && !exitgame)
+	{
+		mvprintw(view.height+10, 0, "at %d,%d, %zu tiles revealed, %zu chunks in memory (%zu KiB)",
+				cursor.x, cursor.y, field.revealed, field.chunkcount,
+				field.chunkcount * sizeof(struct field_chunk) / 1024);
+		clrtoeol();
+	}
+	wmove(window, cursor.y-view.y+1, ((cursor.x-view.x)*TILEGAP)+1);
+	wnoutrefresh(stdscr);
+	wnoutrefresh(window);
+	doupdate();
+}
+
+int
+waitkey()
+{
+	/*
+	 * blocks for a key. while recording, actions the recorder still holds
+	 * are written out once DEMO_FLUSH_US passes without one
+	 */
+	if (recorder && demo_record_pending(recorder))
+	{
+		timeout(DEMO_FLUSH_US / 1000);
+		int ch = getch();
+		timeout(-1);
+		if (ch != ERR)
+			return ch;
+		demo_record_flush(recorder);
+	}
+	return getch();
 }
 
 enum DEMO_ACTION_TYPE
 input()
 {
-	int ch = getch(); /* blocking */
+	int ch = waitkey();
 	enum DEMO_ACTION_TYPE type = NONE;
-	struct tile *tile = gettileat(cursor.x, cursor.y);
+	struct tile tile;
+	int valid = gettile(cursor.x, cursor.y, &tile);
 	switch(ch)
 	{
 		case 'k':
@@ -360,22 +403,31 @@ input()
 			break;
 		case 'f':
 			{
-				if (tile && tile->state & HIDDEN)
+				if (valid && tile.state & HIDDEN)
 				{
 					type = FLAG;
-					tile->state ^= FLAGGED;
+					if (game.is_infinite)
+						field_toggleflag(&field, cursor.x, cursor.y);
+					else
+						board_toggleflag(&board, cursor.x, cursor.y);
 					draw();
 				}
 				 break;
 			}
 		case ' ':
-			if (tile && !(tile->state & FLAGGED))
+			if (valid && !(tile.state & FLAGGED))
 			{
 				type = REVEAL;
-				exitgame = reveal(cursor.x, cursor.y);
+				if (game.is_infinite)
+					exitgame = field_reveal(&field, cursor.x, cursor.y, NULL);
+				else
+					exitgame = board_reveal(&board, cursor.x, cursor.y, NULL);
 			}
 			 break;
 
+		case KEY_RESIZE:
+			fullredraw = 1;
+			break;
 		case 'q':
 			 type = QUIT;
 			exitgame = 1;
@@ -386,233 +438,220 @@ input()
 	return type;
 }
 
-void
-free_action_list()
-{
-	struct action_node *node;
-	while (action_head)
-	{
-		node = action_head;
-		action_head = action_head->next;
-		free(node->action);
-		free(node);
-	}
-}
-
-struct action_node *generate_action_node(double delay, enum DEMO_ACTION_TYPE type, int x, int y)
-{
-	struct action_node *node = malloc(sizeof(struct action_node));
-	struct demo_action  *action = malloc(sizeof(struct demo_action));
-	if (!node || !action)
-		return NULL;
-	action->action_pre_delay = delay;
-	action->start_x = x;
-	action->start_y = y;
-	action->type = type;
-	node->action = action;
-	node->next = NULL;
-	return node;
-}
-
-int append_action_node(struct action_node *node)
+int
+start_recording()
 {
-	struct action_node **finger = &action_head;
-	while (*finger)
-	{
-		finger = &(*finger)->next;
-	}
-	node->next = *finger;
-	*finger = node;
-	return 1;
-}
-
-void print_nodes()
-{
-	struct action_node *finger = action_head;
-	while (finger)
-	{
-		if (finger->action)
-		{
-			printf("%d,%d\n", finger->action->start_x, finger->action->start_y);
-		}
-		finger = finger->next;
-	}
+	/* actions go straight to disk, nothing is kept in memory while recording */
+	/* a random board is saved as its seed, a no-guess one as its mines */
+	struct demo_start start = { !game.is_noguess, game.rng, game.seed, cursor.x, cursor.y };
+	recorder = demo_record_open(game.demo_filename, &board, &start);
+	return recorder != NULL;
 }
 
 void
-save_demo()
+stop_recording()
 {
 	printf("saving demo to %s..\n", game.demo_filename);
-
-	/* open demo file */
-	FILE *demo = fopen(game.demo_filename, "wb");
-	if (!demo)
+	if (!recorder)
 	{
 		puts("cannot open demo file");
 		return;
 	}
-
-	/* generate header and write */
-	struct demo_header header;
-	header.width = game.width;
-	header.height = game.height;
-	header.mine_count = game.minecount;
-
-	fwrite(&header, sizeof(struct demo_header), 1, demo);
-
-	/* generate mines and write */
-	struct demo_mine demo_mines[game.minecount];
-	/* loop over every tile and save it if it's a mine */
-	int i = 0;
-	for (int x = 0; x < game.width; x++)
+	int count = demo_record_close(recorder);
+	recorder = NULL;
+	if (count < 0)
 	{
-		for (int y = 0; y < game.height; y++)
-		{
-			struct tile *tile = gettileat(x, y);
-			if (tile->state & MINE)
-			{
-				demo_mines[i].x = tile->x;
-				demo_mines[i].y = tile->y;
-				fwrite(&demo_mines[i], sizeof(struct demo_mine), 1, demo);
-				i++;
-			}
-		}
-	}
-
-	/* walk action list and write it to file */
-	fwrite(&game.action_count, sizeof game.action_count, 1, demo);
-	/* skip first node */
-	if (!action_head->next)
-	{
-		puts("cannot write demo file, no actions exist..");
-		fclose(demo);
+		puts("cannot write demo file");
 		return;
 	}
-	struct action_node *finger = action_head->next;
-	int x = 0;
-	while (finger)
-	{
-		struct demo_action *action = finger->action;
-		fwrite(action, sizeof(struct demo_action), 1, demo);
-		finger = finger->next;
-		x++;
-	}
-		printf("saved 0x%x nodes\n", x);
-	fclose(demo);
+	printf("saved 0x%x actions\n", count);
 }
 
 int
 load_demo()
 {
 	printf("reading demo %s..\n", game.demo_filename);
-	FILE *demo = fopen(game.demo_filename, "rb");
-	if (!demo)
+	int status = demo_load(game.demo_filename, &board, &action_log);
+	if (status < 0)
 	{
 		puts("unable to read demo..");
 		return 0;
 	}
-
-	/* read header and set data */
-	struct demo_header header;
-	fread(&header, sizeof(struct demo_header), 1, demo);
-	game.width = header.width;
-	game.height = header.height;
-	game.minecount = header.mine_count;
-	/* malloc board here because we need the header information from the demo */
-	board = malloc(sizeof (struct tile) * (game.width * game.height));
-	/* read and set mine data */
-	struct demo_mine demo_mine;
-	for (int mc = 0; mc < game.minecount; mc++)
+	else if (status == 0)
 	{
-		fread(&demo_mine, sizeof(struct demo_mine), 1, demo);
-		/* set tile as mine */
-		struct tile *tile = gettileat(demo_mine.x, demo_mine.y);
-		if (!tile)
-		{
-			puts("demo corrupt");
-			fclose(demo);
-			return 0;
-		}
-		tile->state |= MINE;
+		puts("demo corrupt");
+		return 0;
 	}
+	game.width = board.width;
+	game.height = board.height;
+	game.minecount = board.minecount;
+	cursor.x = action_log.startx;
+	cursor.y = action_log.starty;
+	return 1;
+}
 
-	/* read move data and add action to the list */
-	int action_count;
-	fread(&action_count, sizeof action_count, 1, demo);
-	for (int ac = 0; ac < action_count; ac++)
-	{
-		struct demo_action action;
-		fread(&action, sizeof(struct demo_action), 1, demo);
-		struct action_node *move = generate_action_node(action.action_pre_delay, action.type, action.start_x, action.start_y);
-		append_action_node(move);
-	}
+int
+play_demo_action(struct demo_action *action)
+{
+	replay.board = &board;
+	replay.x = cursor.x;
+	replay.y = cursor.y;
+	if (!demo_step(&replay, action))
+		return 0;
+	cursor.x = replay.x;
+	cursor.y = replay.y;
+	if (replay.outcome == DEMO_LOST || replay.outcome == DEMO_QUIT)
+		exitgame = 1;
+	return 1;
+}
 
-	fclose(demo);
+void
+seek_demo(int target)
+{
+	/* jump from the nearest keyframe, the board reports itself fully changed */
+	replay.board = &board;
+	current_action = demo_seek(&replay, &action_log, target);
+	cursor.x = replay.x;
+	cursor.y = replay.y;
+	resync_demo();
+}
 
-	return 1;
+void
+resync_demo()
+{
+	/* restart the schedule from now, after a pause, seek or speed change */
+	clock_gettime(CLOCK_MONOTONIC, &epoch);
+	since_epoch = 0;
 }
 
-struct action_node *play_demo_action(struct action_node *current_action)
+void
+play_demo()
 {
+	/*
+	 * play every action whose deadline has passed and let the caller draw
+	 * once, if drawing falls behind the skipped frames are never drawn.
+	 * deadlines are absolute so time spent drawing is not added to delays
+	 */
+	struct timespec now, due;
+	int ch;
+	while ((ch = getch()) != ERR)
+		demo_controls(ch);
+	if (exitgame)
+		return;
+	if (paused)
+	{
+		timeout(-1);
+		demo_controls(getch());
+		timeout(0);
+		return;
+	}
+	if (current_action >= action_log.count)
+	{
+		exitgame = 1;
+		return;
+	}
 
-	struct demo_action *action = current_action->action;
-	usleep(action->action_pre_delay);
-	struct tile *tile = gettileat(action->start_x, action->start_y);
-	if (!tile)
-		return NULL;
-	switch (action->type)
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long long start = now.tv_sec * 1000000000LL + now.tv_nsec;
+	long long base = epoch.tv_sec * 1000000000LL + epoch.tv_nsec;
+	long long deadline = base;
+	int played = 0;
+	while (current_action < action_log.count && replay.outcome == DEMO_PLAYING && !exitgame)
 	{
-		case GOUP:
-			if (canmove(UP))
-			{
-				cursor.y--;
-			}
+		struct demo_action *action = &action_log.actions[current_action];
+		if (speeds[speed] > 0)
+			deadline = base + (long long)((since_epoch + action->action_pre_delay) * 1000 / speeds[speed]);
+		if (deadline > now.tv_sec * 1000000000LL + now.tv_nsec)
 			break;
-
-		case GODOWN:
-			if (canmove(DOWN))
-			{
-				cursor.y++;
-			}
+		since_epoch += action->action_pre_delay;
+		current_action++;
+		if (!play_demo_action(action))
+			current_action = action_log.count;
+		played = 1;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec * 1000000000LL + now.tv_nsec - start >= FRAME_NS)
 			break;
+	}
+	if (played)
+		return;
 
-		case GOLEFT:
-			if (canmove(LEFT))
-			{
-				cursor.x--;
-			}
+	/* nothing due yet, sleep until it is or until the next key poll */
+	if (deadline - start > POLL_NS)
+		deadline = start + POLL_NS;
+	due.tv_sec = deadline / 1000000000LL;
+	due.tv_nsec = deadline % 1000000000LL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+		;
+}
+
+void
+demo_controls(int ch)
+{
+	int step = action_log.count / 10 > 0 ? action_log.count / 10 : 1;
+	switch (ch)
+	{
+		case ' ':
+		case 'p':
+			paused = !paused;
+			resync_demo();
 			break;
-		case GORIGHT:
-			if (canmove(RIGHT))
-			{
-				cursor.x++;
-			}
+		case '-':
+			if (speed > 0)
+				speed--;
+			resync_demo();
 			break;
-		case FLAG:
-			{
-				if (tile && tile->state & HIDDEN)
-				{
-					tile->state ^= FLAGGED;
-					draw();
-				}
-				 break;
-			}
-		case REVEAL:
-			if (tile && !(tile->state & FLAGGED))
-			{
-				exitgame = reveal(action->start_x, action->start_y);
-			}
-			 break;
-
-		case QUIT:
+		case '+':
+		case '=':
+			if (speed < SPEEDCOUNT-1)
+				speed++;
+			resync_demo();
+			break;
+		case 'n':
+			paused = 1;
+			if (current_action < action_log.count)
+				play_demo_action(&action_log.actions[current_action++]);
+			break;
+		case 'b':
+			paused = 1;
+			seek_demo(current_action - 1);
+			break;
+		case '[':
+			seek_demo(current_action - step);
+			break;
+		case ']':
+			seek_demo(current_action + step);
+			break;
+		case 'r':
+			seek_demo(0);
+			break;
+		case KEY_RESIZE:
+			fullredraw = 1;
+			break;
+		case 'q':
 			exitgame = 1;
 			break;
-		case NONE:
 		default:
 			break;
-
 	}
-	return current_action->next;
+}
+
+int
+verify_demo()
+{
+	/* replay without curses or delays and report how the demo ends */
+	struct timespec begin, end;
+	if (!load_demo())
+		return 0;
+	board_countneighbors(&board);
+	struct demo_game check = { &board, action_log.startx, action_log.starty, DEMO_PLAYING };
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	int played = demo_run(&check, &action_log);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	printf("%s: %s, %d/%d actions, %zu tiles revealed, %.0f actions/s\n",
+			game.demo_filename, demo_outcome(check.outcome), played, action_log.count,
+			board.revealed, seconds > 0 ? played / seconds : 0.0);
+	return 1;
 }
 
 int
@@ -620,56 +659,159 @@ main(int argc, char **argv)
 {
 	game.is_demo = 0;
 	game.is_recording = 0;
-	if ((argc > 1 && argc != 3))
-	{
-		printf("usage: %s [-record save.dem | -play load.dem]\n", argv[0]);
-		goto safe_exit;
-	}
-	if (argc == 3)
+	game.seed = time(NULL);
+	game.rng = RNG_XOSHIRO;
+	game.width = WIDTH;
+	game.height = HEIGHT;
+	game.minecount = MINECOUNT;
+	for (int arg = 1; arg < argc; arg += 2)
 	{
-		if (strcmp(argv[1], "-record") == 0)
+		if (strcmp(argv[arg], "-regions") == 0)
+		{
+			/* the only option without a value */
+			game.is_regions = 1;
+			arg--;
+			continue;
+		}
+		if (arg+1 >= argc)
+		{
+			printf("usage: %s [-seed n] [-rng xoshiro|pcg] [-width w] [-height h] [-mines n] [-regions] [-speed x] [-noguess cache] [-infinite density] [-record save.dem | -play load.dem | -verify load.dem]\n", argv[0]);
+			goto safe_exit;
+		}
+		if (strcmp(argv[arg], "-record") == 0)
 		{
 			game.is_recording = 1;
-			strncpy(game.demo_filename, argv[2], 511);
+			strncpy(game.demo_filename, argv[arg+1], 511);
 		}
-		else if (strcmp(argv[1], "-play") == 0)
+		else if (strcmp(argv[arg], "-play") == 0)
 		{
 			game.is_demo = 1;
-			strncpy(game.demo_filename, argv[2], 511);
+			strncpy(game.demo_filename, argv[arg+1], 511);
+		}
+		else if (strcmp(argv[arg], "-verify") == 0)
+		{
+			game.is_verify = 1;
+			strncpy(game.demo_filename, argv[arg+1], 511);
+		}
+		else if (strcmp(argv[arg], "-infinite") == 0)
+		{
+			game.is_infinite = 1;
+			game.density = atoi(argv[arg+1]);
+		}
+		else if (strcmp(argv[arg], "-width") == 0)
+		{
+			game.width = atoi(argv[arg+1]);
+		}
+		else if (strcmp(argv[arg], "-height") == 0)
+		{
+			game.height = atoi(argv[arg+1]);
+		}
+		else if (strcmp(argv[arg], "-mines") == 0)
+		{
+			game.minecount = atoi(argv[arg+1]);
+		}
+		else if (strcmp(argv[arg], "-seed") == 0)
+		{
+			game.seed = strtoull(argv[arg+1], NULL, 0);
+			game.is_seeded = 1;
+		}
+		else if (strcmp(argv[arg], "-rng") == 0 && rng_parse(argv[arg+1], &game.rng))
+		{
+			/* the generator is saved in recorded demos with the seed */
+		}
+		else if (strcmp(argv[arg], "-noguess") == 0)
+		{
+			game.is_noguess = 1;
+			strncpy(game.noguess_filename, argv[arg+1], 511);
+		}
+		else if (strcmp(argv[arg], "-speed") == 0)
+		{
+			/* the nearest speed at or above x, 0 plays instantly */
+			double x = strtod(argv[arg+1], NULL);
+			speed = SPEEDCOUNT-1;
+			for (int i = SPEEDCOUNT-2; i >= 0 && x > 0; i--)
+			{
+				if (speeds[i] >= x || i == SPEEDCOUNT-2)
+					speed = i;
+				else
+					break;
+			}
 		}
 		else
 		{
-			printf("usage: %s [-record save.dem | -play load.dem]\n", argv[0]);
+			printf("usage: %s [-seed n] [-rng xoshiro|pcg] [-width w] [-height h] [-mines n] [-regions] [-speed x] [-noguess cache] [-infinite density] [-record save.dem | -play load.dem | -verify load.dem]\n", argv[0]);
 			goto safe_exit;
 		}
 	}
+	if (game.is_infinite && (game.is_demo || game.is_recording || game.is_verify))
+	{
+		/* demos store a fixed size board */
+		puts("an infinite board cannot be recorded or played back");
+		return 1;
+	}
+	if (game.is_infinite && (game.density <= 0 || game.density >= 100))
+	{
+		puts("density is the percentage of mines, 1 to 99");
+		return 1;
+	}
+	if (game.is_noguess && (game.is_infinite || game.is_demo || game.is_verify))
+	{
+		/* demos already store their mines */
+		puts("-noguess only works with a new fixed size board");
+		return 1;
+	}
+	if (!game.is_infinite && (game.width <= 0 || game.height <= 0 || game.minecount <= 0 ||
+			(long long)game.minecount >= (long long)game.width * game.height))
+	{
+		puts("the board needs a width and height of at least 1 and fewer mines than tiles");
+		return 1;
+	}
+	if (game.is_noguess)
+	{
+		/* a cached board if there is one, a seed given on the command line is always generated */
+		noguess = (struct noguess_board){ game.width, game.height, game.minecount,
+			game.width / 2, game.height / 2, game.seed, 0, game.rng };
+		if (!(!game.is_seeded && noguess_take(game.noguess_filename, &noguess)))
+		{
+			printf("looking for a board that needs no guessing..\n");
+			if (!noguess_generate(&noguess, 0))
+			{
+				puts("cannot generate board");
+				return 1;
+			}
+		}
+		game.seed = noguess.seed;
+		/* start on the click the board was checked from */
+		cursor.x = noguess.x;
+		cursor.y = noguess.y;
+	}
+	if (game.is_verify)
+	{
+		int ok = verify_demo();
+		board_free(&board);
+		actionlog_free(&action_log);
+		return !ok;
+	}
 	initscr();
 	noecho();
-	game.width = WIDTH;
-	game.height = HEIGHT;
-	game.minecount = MINECOUNT;
-	game.action_count = 0;
-	action_head = malloc(sizeof(struct action_node));
-	action_head->action = NULL;
-	action_head->next = NULL;
-	if (!action_head)
-		goto safe_exit;
 	if (!generateboard())
 		goto safe_exit;
+	board_trackchanges(&board, 1);
+	if (game.is_demo)
+	{
+		timeout(0);
+		resync_demo();
+	}
+	if (game.is_recording && !start_recording())
+		goto safe_exit;
 	struct timespec begin, end;
 	double move_us;
-	struct action_node *current_action = action_head->next;
 	while(!exitgame)
 	{
 		draw();
 		if (game.is_demo)
 		{
-			if (current_action)
-			{
-				current_action = play_demo_action(current_action);
-			}
-			else
-				exitgame = 1;
+			play_demo();
 		}
 		else
 		{
@@ -679,36 +821,40 @@ main(int argc, char **argv)
 			move_us = (end.tv_sec - begin.tv_sec) * 1000.0;
 			move_us += (end.tv_nsec - begin.tv_nsec) / 1000000.0;
 			move_us *= 1000;
-			struct action_node *move = generate_action_node(move_us, type, cursor.x, cursor.y);
-			append_action_node(move);
-			game.action_count++;
+			if (recorder)
+				demo_record_append(recorder, move_us, type, cursor.x, cursor.y);
 			//printf("%.3f us elapsed\n", move_us);
 		}
-		if (checkwin())
+		if (!game.is_infinite && board_checkwin(&board))
 		{
 			exitgame = 1;
-			revealmines();
+			board_revealmines(&board);
+			fullredraw = 1;
 			draw();
-			mvprintw(game.height+3, 0, "you won");
+			mvprintw(view.height+3, 0, "you won");
 			break;
 		}
 		else if (exitgame)
 		{
-			revealmines();
+			if (!game.is_infinite)
+				board_revealmines(&board);
+			fullredraw = 1;
 			draw();
-			mvprintw(game.height+3, 0, "you lost");
+			mvprintw(view.height+3, 0, "you lost");
 			break;
 		}
 	}
-	mvprintw(game.height+4, 0, "press any key to exit..");
+	mvprintw(view.height+4, 0, "press any key to exit..");
+	timeout(-1);
 	flushinp();
 	getch();
 safe_exit:
 	delwin(window);
 	endwin();
 	if (game.is_recording)
-		save_demo();
-	free(board);
-	free_action_list();
+		stop_recording();
+	board_free(&board);
+	field_free(&field);
+	actionlog_free(&action_log);
 	return 0;
 }
@@ -0,0 +1,272 @@
+/*
+ * minesweeper boards that never need a guess (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "noguess.h"
+#include "solver.h"
+
+/* shared between the workers of one noguess_generate() */
+struct hunt
+{
+	const struct noguess_board *want;
+	long next;
+	long best;	/* lowest accepted candidate, LONG_MAX until one is */
+	int failed;
+	pthread_mutex_t lock;
+};
+
+static void placemines(struct board *board, int count, struct rng *rng, int x, int y);
+static int abandoned(struct hunt *hunt, long candidate);
+static int solves(struct board *board, int x, int y, struct hunt *hunt, long candidate);
+static void *worker(void *arg);
+
+static void
+placemines(struct board *board, int count, struct rng *rng, int x, int y)
+{
+	/*
+	 * floyd's sampling as in board_placemines(), over the tiles outside the
+	 * block around x, y. a draw is turned into a tile by stepping over the
+	 * skipped tiles below it, which are kept in order
+	 */
+	size_t skip[9], skipcount = 0;
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			if (board_contains(board, x + dx, y + dy))
+				skip[skipcount++] = (size_t)(y + dy) * board->width + (x + dx);
+		}
+	}
+	size_t tiles = board->tiles - skipcount;
+	if ((size_t)count > tiles)
+		count = tiles;
+	for (size_t j = tiles - count; j < tiles; j++)
+	{
+		size_t t = rng_below(rng, j + 1);
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (size_t s = 0; s < skipcount; s++)
+			{
+				if (skip[s] <= t)
+					t++;
+			}
+			if (pass == 0 && board_state(board, t % board->width, t / board->width) & MINE)
+			{
+				/* the drawn tile is taken, use the newest candidate instead */
+				t = j;
+				continue;
+			}
+			break;
+		}
+		board_setmine(board, t % board->width, t / board->width);
+	}
+}
+
+int
+noguess_build(struct board *board, const struct noguess_board *ng)
+{
+	struct rng rng;
+	if (!board_init(board, ng->width, ng->height))
+		return 0;
+	rng_seed(&rng, ng->rng, rng_hash(ng->seed, ng->candidate));
+	placemines(board, ng->minecount, &rng, ng->x, ng->y);
+	board_countneighbors(board);
+	return 1;
+}
+
+static int
+abandoned(struct hunt *hunt, long candidate)
+{
+	/* a lower candidate has already been accepted */
+	int stop;
+	if (!hunt)
+		return 0;
+	pthread_mutex_lock(&hunt->lock);
+	stop = candidate > hunt->best;
+	pthread_mutex_unlock(&hunt->lock);
+	return stop;
+}
+
+static int
+solves(struct board *board, int x, int y, struct hunt *hunt, long candidate)
+{
+	/*
+	 * open x, y then everything the solver proves safe, a round at a time,
+	 * until it is stuck or the board is clear
+	 */
+	struct solver solver;
+	size_t opened;
+	if (board_reveal(board, x, y, &opened) || !solver_init(&solver, board))
+		return 0;
+	while (!board_checkwin(board) && !abandoned(hunt, candidate))
+	{
+		solver_sync(&solver);
+		solver_run(&solver);
+		if (!solver.safecount)
+			break;
+		solver_opensafe(&solver, board);
+	}
+	solver_free(&solver);
+	return board_checkwin(board);
+}
+
+int
+noguess_solvable(struct board *board, int x, int y)
+{
+	/* plays the board out from x, y, so it is left part revealed */
+	return solves(board, x, y, NULL, 0);
+}
+
+static void *
+worker(void *arg)
+{
+	struct hunt *hunt = arg;
+	struct noguess_board ng = *hunt->want;
+	struct board board;
+	for (;;)
+	{
+		pthread_mutex_lock(&hunt->lock);
+		long candidate = hunt->next++;
+		int stop = candidate > hunt->best || candidate >= NOGUESS_MAXCANDIDATES || hunt->failed;
+		pthread_mutex_unlock(&hunt->lock);
+		if (stop)
+			break;
+		ng.candidate = candidate;
+		if (!noguess_build(&board, &ng))
+		{
+			pthread_mutex_lock(&hunt->lock);
+			hunt->failed = 1;
+			pthread_mutex_unlock(&hunt->lock);
+			break;
+		}
+		int ok = solves(&board, ng.x, ng.y, hunt, candidate);
+		board_free(&board);
+		if (ok)
+		{
+			pthread_mutex_lock(&hunt->lock);
+			if (candidate < hunt->best)
+				hunt->best = candidate;
+			pthread_mutex_unlock(&hunt->lock);
+		}
+	}
+	return NULL;
+}
+
+int
+noguess_generate(struct noguess_board *ng, int threads)
+{
+	/*
+	 * find the first candidate of ng's seed that needs no guessing and
+	 * store it in ng->candidate. threads below 1 uses every core. returns
+	 * 0 if no candidate up to NOGUESS_MAXCANDIDATES passes
+	 */
+	struct hunt hunt = { ng, 0, LONG_MAX, 0, PTHREAD_MUTEX_INITIALIZER };
+	pthread_t pool[NOGUESS_MAXTHREADS];
+	int started = 0;
+	if (ng->width <= 0 || ng->height <= 0 || !(ng->x >= 0 && ng->x < ng->width && ng->y >= 0 && ng->y < ng->height))
+		return 0;
+	/* room for every mine outside the first click's block */
+	if ((long long)ng->minecount > (long long)ng->width * ng->height - 9)
+		return 0;
+	if (threads < 1)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > NOGUESS_MAXTHREADS)
+		threads = NOGUESS_MAXTHREADS;
+	/* the calling thread is one of the workers */
+	for (; started < threads - 1; started++)
+	{
+		if (pthread_create(&pool[started], NULL, worker, &hunt) != 0)
+			break;
+	}
+	worker(&hunt);
+	for (int t = 0; t < started; t++)
+		pthread_join(pool[t], NULL);
+	pthread_mutex_destroy(&hunt.lock);
+	if (hunt.failed || hunt.best == LONG_MAX)
+		return 0;
+	ng->candidate = hunt.best;
+	return 1;
+}
+
+int
+noguess_take(const char *path, struct noguess_board *ng)
+{
+	/*
+	 * the first cached board of ng's size, mine count and rng, which is removed
+	 * from the cache. returns 0 and leaves ng alone if there is none or it
+	 * could not be removed, so the same board is never handed out twice
+	 */
+	char line[256], temp[4096], name[16];
+	struct noguess_board taken;
+	int found = 0;
+	FILE *in = fopen(path, "r");
+	if (!in)
+		return 0;
+	snprintf(temp, sizeof temp, "%s.tmp", path);
+	FILE *out = fopen(temp, "w");
+	if (!out)
+	{
+		fclose(in);
+		return 0;
+	}
+	while (fgets(line, sizeof line, in))
+	{
+		struct noguess_board entry;
+		unsigned long long seed;
+		int fields = sscanf(line, "%d %d %d %d %d %llu %ld %15s", &entry.width, &entry.height,
+				&entry.minecount, &entry.x, &entry.y, &seed, &entry.candidate, name);
+		entry.rng = RNG_XOSHIRO;
+		if (fields == 8 && !rng_parse(name, &entry.rng))
+			fields = 0;
+		/* a line with the first click off the board is left alone, like any other miss */
+		if (fields >= 7 && !(entry.x >= 0 && entry.x < entry.width && entry.y >= 0 && entry.y < entry.height))
+			fields = 0;
+		if (!found && fields >= 7 && entry.rng == ng->rng &&
+				entry.width == ng->width && entry.height == ng->height && entry.minecount == ng->minecount)
+		{
+			entry.seed = seed;
+			taken = entry;
+			found = 1;
+			continue;
+		}
+		fputs(line, out);
+	}
+	fclose(in);
+	if (fclose(out) != 0 || !found || rename(temp, path) != 0)
+	{
+		remove(temp);
+		return 0;
+	}
+	*ng = taken;
+	return 1;
+}
+
+int
+noguess_store(const char *path, const struct noguess_board *ng)
+{
+	FILE *out = fopen(path, "a");
+	if (!out)
+		return 0;
+	fprintf(out, "%d %d %d %d %d %llu %ld %s\n", ng->width, ng->height, ng->minecount,
+			ng->x, ng->y, (unsigned long long)ng->seed, ng->candidate, rng_name(ng->rng));
+	return fclose(out) == 0;
+}
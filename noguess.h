@@ -0,0 +1,58 @@
+/*
+ * minesweeper boards that never need a guess (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOGUESS_H
+#define NOGUESS_H
+
+#include <stdint.h>
+#include "board.h"
+
+#define NOGUESS_MAXTHREADS 64
+#define NOGUESS_MAXCANDIDATES 1000000
+
+/*
+ * candidate boards keep mines off the first click and its neighbors, so
+ * the first click always opens an area. a candidate is accepted when the
+ * solver can clear it from there without guessing. candidate n of a seed
+ * takes its mines from rng seeded with rng_hash(seed, n), so a board is
+ * saved as the numbers below and rebuilt with noguess_build().
+ *
+ * candidates are checked in parallel but the lowest accepted one always
+ * wins, so a seed gives the same board on any number of threads
+ *
+ * the cache is a text file, one board a line:
+ *	width height mines x y seed candidate rng
+ * where rng is a name rng_parse() takes, lines without it are xoshiro
+ */
+struct noguess_board
+{
+	int width;
+	int height;
+	int minecount;
+	int x, y;	/* the first click */
+	uint64_t seed;
+	long candidate;
+	enum RNG_TYPE rng;
+};
+
+int noguess_build(struct board *board, const struct noguess_board *ng);
+int noguess_solvable(struct board *board, int x, int y);
+int noguess_generate(struct noguess_board *ng, int threads);
+int noguess_take(const char *path, struct noguess_board *ng);
+int noguess_store(const char *path, const struct noguess_board *ng);
+
+#endif
@@ -0,0 +1,666 @@
+/*
+ * minesweeper mine probabilities (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "odds.h"
+
+/* a revealed number, tiles are frontier ids */
+struct constraint
+{
+	int need;
+	int count;
+	int tiles[8];
+};
+
+/* order[first] up to order[first+count] are the component's tiles in search order */
+struct component
+{
+	int first;
+	int count;
+};
+
+/*
+ * part of one component's search, the first prefixlen tiles are fixed to
+ * the bits of prefix. counts[k] is how many arrangements have k mines and
+ * tilecounts[d*(count+1)+k] how many of those have a mine on tile d
+ */
+struct task
+{
+	int component;
+	int size;	/* tiles in the component */
+	int prefix;
+	int prefixlen;
+	int over;	/* ran out of steps, the counts are incomplete */
+	double *counts;
+	double *tilecounts;
+};
+
+/* everything one odds_compute() call shares between its workers */
+struct frontier
+{
+	const struct board *board;
+	int tilecount;
+	size_t *index;	/* board index of each frontier tile */
+	int *order;
+	int *links;	/* the constraints of tile t are links[t*8] onwards */
+	int *linkcount;
+	struct constraint *constraints;
+	int constraintcount;
+	struct component *components;
+	int componentcount;
+	struct task *tasks;
+	struct task **schedule;	/* tasks biggest component first */
+	int taskcount;
+	int nexttask;
+	int failed;
+	pthread_mutex_t lock;
+};
+
+/* one worker's search state */
+struct search
+{
+	const struct frontier *frontier;
+	struct task *task;
+	const int *order;
+	int count;
+	int mines;
+	int *have;	/* mines placed next to each constraint */
+	int *left;	/* its tiles still to decide */
+	int *placed;	/* depths holding a mine, mines of them */
+	long nodes;
+	long limit;
+};
+
+static int buildfrontier(struct odds *odds, struct frontier *frontier, int *id);
+static int orderfrontier(struct frontier *frontier);
+static int maketasks(struct frontier *frontier);
+static int cmptask(const void *a, const void *b);
+static void search(struct search *s, int depth);
+static void *worker(void *arg);
+static double *convolve(const double *a, int alen, const double *b, int blen);
+static double lnchoose(double n, double k);
+static int combine(struct odds *odds, struct frontier *frontier, const int *id);
+static void freefrontier(struct frontier *frontier);
+
+int
+odds_init(struct odds *odds, const struct solver *solver, int threads)
+{
+	memset(odds, 0, sizeof *odds);
+	odds->solver = solver;
+	odds->threads = threads < 1 ? 1 : threads > ODDS_MAXTHREADS ? ODDS_MAXTHREADS : threads;
+	odds->probability = calloc(solver->board->bits, sizeof(double));
+	return odds->probability != NULL;
+}
+
+void
+odds_free(struct odds *odds)
+{
+	free(odds->probability);
+	memset(odds, 0, sizeof *odds);
+}
+
+static int
+buildfrontier(struct odds *odds, struct frontier *frontier, int *id)
+{
+	/*
+	 * a constraint for every revealed number with unsettled hidden
+	 * neighbors, which become frontier tiles. id maps board indexes to
+	 * frontier ids and is -1 off the frontier
+	 */
+	const struct solver *solver = odds->solver;
+	const struct board *board = solver->board;
+	size_t neighbors[8];
+	int count = 0;
+	frontier->index = malloc(board->tiles * sizeof(size_t));
+	frontier->constraints = malloc(board->tiles * sizeof(struct constraint));
+	if (!frontier->index || !frontier->constraints)
+		return 0;
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t i = board_index(board, x, y);
+			if (BOARD_TEST(board->hidden, i) || BOARD_TEST(board->mine, i))
+				continue;
+			struct constraint *c = &frontier->constraints[frontier->constraintcount];
+			c->need = board_countat(board, i);
+			c->count = 0;
+			board_neighbors(board, i, neighbors);
+			for (int n = 0; n < 8; n++)
+			{
+				size_t t = neighbors[n];
+				if (BOARD_TEST(solver->mine, t))
+					c->need--;
+				else if (BOARD_TEST(board->hidden, t) && !BOARD_TEST(solver->safe, t))
+				{
+					if (id[t] < 0)
+					{
+						id[t] = count;
+						frontier->index[count++] = t;
+					}
+					c->tiles[c->count++] = id[t];
+				}
+			}
+			if (c->count)
+				frontier->constraintcount++;
+		}
+	}
+	frontier->tilecount = count;
+	odds->frontier = count;
+	return 1;
+}
+
+static int
+orderfrontier(struct frontier *frontier)
+{
+	/*
+	 * group the tiles sharing constraints into components, then lay each
+	 * component out breadth first so the search closes constraints early
+	 */
+	int count = frontier->tilecount;
+	size_t *parent = malloc((count + 1) * sizeof(size_t));
+	int *component = malloc((count + 1) * sizeof(int));
+	int *placed = calloc(count + 1, sizeof(int));
+	frontier->links = malloc((count + 1) * 8 * sizeof(int));
+	frontier->linkcount = calloc(count + 1, sizeof(int));
+	frontier->order = malloc((count + 1) * sizeof(int));
+	frontier->components = malloc((count + 1) * sizeof(struct component));
+	if (!parent || !component || !placed || !frontier->links || !frontier->linkcount ||
+			!frontier->order || !frontier->components)
+	{
+		free(parent);
+		free(component);
+		free(placed);
+		return 0;
+	}
+	for (int t = 0; t < count; t++)
+		parent[t] = t;
+	for (int c = 0; c < frontier->constraintcount; c++)
+	{
+		struct constraint *con = &frontier->constraints[c];
+		size_t root = board_findroot(parent, con->tiles[0]);
+		for (int k = 0; k < con->count; k++)
+		{
+			int t = con->tiles[k];
+			frontier->links[t*8 + frontier->linkcount[t]++] = c;
+			parent[board_findroot(parent, t)] = root;
+			root = board_findroot(parent, root);
+		}
+	}
+	/* components numbered by their first tile, sized before they are laid out */
+	for (int t = 0; t < count; t++)
+		component[t] = -1;
+	for (int t = 0; t < count; t++)
+	{
+		size_t root = board_findroot(parent, t);
+		if (component[root] < 0)
+		{
+			component[root] = frontier->componentcount;
+			frontier->components[frontier->componentcount].count = 0;
+			frontier->componentcount++;
+		}
+		frontier->components[component[root]].count++;
+	}
+	int first = 0;
+	for (int c = 0; c < frontier->componentcount; c++)
+	{
+		frontier->components[c].first = first;
+		first += frontier->components[c].count;
+	}
+	for (int t = 0; t < count; t++)
+	{
+		struct component *comp = &frontier->components[component[board_findroot(parent, t)]];
+		int *queue = frontier->order + comp->first;
+		int head = 0, tail = 0;
+		if (placed[t])
+			continue;
+		queue[tail++] = t;
+		placed[t] = 1;
+		while (head < tail)
+		{
+			int tile = queue[head++];
+			for (int l = 0; l < frontier->linkcount[tile]; l++)
+			{
+				const struct constraint *con = &frontier->constraints[frontier->links[tile*8 + l]];
+				for (int k = 0; k < con->count; k++)
+				{
+					if (!placed[con->tiles[k]])
+					{
+						placed[con->tiles[k]] = 1;
+						queue[tail++] = con->tiles[k];
+					}
+				}
+			}
+		}
+	}
+	free(parent);
+	free(component);
+	free(placed);
+	return 1;
+}
+
+static int
+cmptask(const void *a, const void *b)
+{
+	/* bigger components first, so the long searches start straight away */
+	const struct task *ta = *(struct task * const *)a, *tb = *(struct task * const *)b;
+	if (ta->size != tb->size)
+		return tb->size - ta->size;
+	return (ta > tb) - (ta < tb);
+}
+
+static int
+maketasks(struct frontier *frontier)
+{
+	for (int c = 0; c < frontier->componentcount; c++)
+		frontier->taskcount += frontier->components[c].count >= ODDS_SPLIT ? 1 << ODDS_SPLITBITS : 1;
+	frontier->tasks = calloc(frontier->taskcount, sizeof(struct task));
+	frontier->schedule = malloc(frontier->taskcount * sizeof(struct task *));
+	if (!frontier->tasks || !frontier->schedule)
+		return 0;
+	struct task *task = frontier->tasks;
+	for (int c = 0; c < frontier->componentcount; c++)
+	{
+		int n = frontier->components[c].count;
+		int split = n >= ODDS_SPLIT ? ODDS_SPLITBITS : 0;
+		for (int p = 0; p < 1 << split; p++, task++)
+		{
+			task->component = c;
+			task->size = n;
+			task->prefix = p;
+			task->prefixlen = split;
+			task->counts = calloc(n + 1, sizeof(double));
+			task->tilecounts = calloc((size_t)n * (n + 1), sizeof(double));
+			if (!task->counts || !task->tilecounts)
+				return 0;
+		}
+	}
+	for (int t = 0; t < frontier->taskcount; t++)
+		frontier->schedule[t] = &frontier->tasks[t];
+	qsort(frontier->schedule, frontier->taskcount, sizeof(struct task *), cmptask);
+	return 1;
+}
+
+static void
+search(struct search *s, int depth)
+{
+	/* try each tile as safe then as a mine, backing out of any number it breaks */
+	const struct frontier *frontier = s->frontier;
+	if (s->task->over || ++s->nodes > s->limit)
+	{
+		s->task->over = 1;
+		return;
+	}
+	if (depth == s->count)
+	{
+		int stride = s->count + 1;
+		s->task->counts[s->mines]++;
+		for (int m = 0; m < s->mines; m++)
+			s->task->tilecounts[s->placed[m] * stride + s->mines]++;
+		return;
+	}
+	int tile = s->order[depth];
+	const int *links = frontier->links + tile*8;
+	for (int v = 0; v <= 1; v++)
+	{
+		int ok = 1;
+		if (depth < s->task->prefixlen && v != ((s->task->prefix >> depth) & 1))
+			continue;
+		for (int l = 0; l < frontier->linkcount[tile]; l++)
+		{
+			int c = links[l], need = frontier->constraints[c].need;
+			s->left[c]--;
+			s->have[c] += v;
+			if (s->have[c] > need || s->have[c] + s->left[c] < need)
+				ok = 0;
+		}
+		if (ok)
+		{
+			s->placed[s->mines] = depth;
+			s->mines += v;
+			search(s, depth + 1);
+			s->mines -= v;
+		}
+		for (int l = 0; l < frontier->linkcount[tile]; l++)
+		{
+			s->left[links[l]]++;
+			s->have[links[l]] -= v;
+		}
+	}
+}
+
+static void *
+worker(void *arg)
+{
+	/* each worker takes the next task until there are none left */
+	struct frontier *frontier = arg;
+	struct search s;
+	int largest = 0;
+	for (int c = 0; c < frontier->componentcount; c++)
+	{
+		if (frontier->components[c].count > largest)
+			largest = frontier->components[c].count;
+	}
+	s.frontier = frontier;
+	s.have = malloc((frontier->constraintcount + 1) * sizeof(int));
+	s.left = malloc((frontier->constraintcount + 1) * sizeof(int));
+	s.placed = malloc((largest + 1) * sizeof(int));
+	if (!s.have || !s.left || !s.placed)
+	{
+		pthread_mutex_lock(&frontier->lock);
+		frontier->failed = 1;
+		pthread_mutex_unlock(&frontier->lock);
+		goto done;
+	}
+	for (;;)
+	{
+		pthread_mutex_lock(&frontier->lock);
+		int next = frontier->nexttask++;
+		pthread_mutex_unlock(&frontier->lock);
+		if (next >= frontier->taskcount)
+			break;
+		struct task *task = frontier->schedule[next];
+		const struct component *comp = &frontier->components[task->component];
+		s.task = task;
+		s.order = frontier->order + comp->first;
+		s.count = comp->count;
+		s.mines = 0;
+		s.nodes = 0;
+		s.limit = ODDS_MAXNODES >> task->prefixlen;
+		for (int d = 0; d < comp->count; d++)
+		{
+			int tile = s.order[d];
+			for (int l = 0; l < frontier->linkcount[tile]; l++)
+			{
+				int c = frontier->links[tile*8 + l];
+				s.have[c] = 0;
+				s.left[c] = frontier->constraints[c].count;
+			}
+		}
+		search(&s, 0);
+	}
+done:
+	free(s.have);
+	free(s.left);
+	free(s.placed);
+	return NULL;
+}
+
+static double *
+convolve(const double *a, int alen, const double *b, int blen)
+{
+	double *out = calloc(alen + blen - 1, sizeof(double));
+	if (!out)
+		return NULL;
+	for (int i = 0; i < alen; i++)
+	{
+		if (a[i] == 0)
+			continue;
+		for (int j = 0; j < blen; j++)
+			out[i + j] += a[i] * b[j];
+	}
+	return out;
+}
+
+static double
+lnchoose(double n, double k)
+{
+	return lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1);
+}
+
+static int
+combine(struct odds *odds, struct frontier *frontier, const int *id)
+{
+	/*
+	 * all[s] is the number of ways the frontier holds s mines, weight[s]
+	 * the ways the other mines fit in the interior, scaled so the largest
+	 * that can happen is 1. a component's tiles are weighed against the
+	 * ways every other component and the interior can make up the rest
+	 */
+	const struct solver *solver = odds->solver;
+	const struct board *board = solver->board;
+	int total = odds->frontier;
+	long mines = (long)board->minecount - (long)solver->minecount;
+	double interior = odds->interior, top = -HUGE_VAL, sum = 0, inside = 0;
+	double *all = calloc(total + 1, sizeof(double));
+	double *weight = calloc(total + 1, sizeof(double));
+	int ok = 0, alllen = 1;
+	if (!all || !weight)
+		goto done;
+	all[0] = 1;
+	/*
+	 * fold split tasks into the component's first task. a component that
+	 * ran out of steps joins the interior, as if no number touched it
+	 */
+	struct task *task = frontier->tasks;
+	for (int c = 0; c < frontier->componentcount; c++)
+	{
+		int n = frontier->components[c].count;
+		int parts = n >= ODDS_SPLIT ? 1 << ODDS_SPLITBITS : 1;
+		for (int p = 1; p < parts; p++)
+		{
+			task[0].over |= task[p].over;
+			for (int k = 0; k <= n; k++)
+				task[0].counts[k] += task[p].counts[k];
+			for (size_t k = 0; k < (size_t)n * (n + 1); k++)
+				task[0].tilecounts[k] += task[p].tilecounts[k];
+		}
+		if (task[0].over)
+		{
+			interior += n;
+			odds->approximate += n;
+			task += parts;
+			continue;
+		}
+		double *next = convolve(all, alllen, task[0].counts, n + 1);
+		if (!next)
+			goto done;
+		free(all);
+		all = next;
+		alllen += n;
+		task += parts;
+	}
+	for (int s = 0; s <= total; s++)
+	{
+		long rest = mines - s;
+		if (all[s] > 0 && rest >= 0 && rest <= interior && lnchoose(interior, rest) > top)
+			top = lnchoose(interior, rest);
+	}
+	for (int s = 0; s <= total; s++)
+	{
+		long rest = mines - s;
+		if (rest >= 0 && rest <= interior)
+			weight[s] = exp(lnchoose(interior, rest) - top);
+		sum += all[s] * weight[s];
+		if (interior > 0)
+			inside += all[s] * weight[s] * (mines - s) / interior;
+	}
+	/* no arrangement fits the numbers and the mine count */
+	if (!(sum > 0))
+		goto done;
+
+	for (size_t i = 0; i < board->bits; i++)
+	{
+		if (BOARD_TEST(solver->mine, i))
+			odds->probability[i] = 1;
+		else if (BOARD_TEST(board->hidden, i) && !BOARD_TEST(solver->safe, i) && id[i] < 0)
+			odds->probability[i] = inside / sum;
+		else
+			odds->probability[i] = 0;
+	}
+	task = frontier->tasks;
+	for (int c = 0; c < frontier->componentcount; c++)
+	{
+		const struct component *comp = &frontier->components[c];
+		int n = comp->count, otherlen = 1;
+		int parts = n >= ODDS_SPLIT ? 1 << ODDS_SPLITBITS : 1;
+		if (task[0].over)
+		{
+			for (int d = 0; d < n; d++)
+				odds->probability[frontier->index[frontier->order[comp->first + d]]] = inside / sum;
+			task += parts;
+			continue;
+		}
+		double *others = calloc(1, sizeof(double)), *ways = calloc(n + 1, sizeof(double));
+		if (!others || !ways)
+		{
+			free(others);
+			free(ways);
+			goto done;
+		}
+		others[0] = 1;
+		struct task *other = frontier->tasks;
+		for (int o = 0; o < frontier->componentcount; o++)
+		{
+			int on = frontier->components[o].count;
+			if (o != c && !other[0].over)
+			{
+				double *next = convolve(others, otherlen, other[0].counts, on + 1);
+				free(others);
+				others = next;
+				otherlen += on;
+				if (!others)
+				{
+					free(ways);
+					goto done;
+				}
+			}
+			other += on >= ODDS_SPLIT ? 1 << ODDS_SPLITBITS : 1;
+		}
+		/* ways[k], the weight of this component holding k mines */
+		for (int k = 0; k <= n; k++)
+		{
+			for (int s = 0; s < otherlen; s++)
+				ways[k] += others[s] * weight[k + s];
+		}
+		for (int d = 0; d < n; d++)
+		{
+			double p = 0;
+			for (int k = 0; k <= n; k++)
+				p += task[0].tilecounts[d * (n + 1) + k] * ways[k];
+			odds->probability[frontier->index[frontier->order[comp->first + d]]] = p / sum;
+		}
+		free(others);
+		free(ways);
+		task += parts;
+	}
+	ok = 1;
+done:
+	free(all);
+	free(weight);
+	return ok;
+}
+
+static void
+freefrontier(struct frontier *frontier)
+{
+	for (int t = 0; t < frontier->taskcount && frontier->tasks; t++)
+	{
+		free(frontier->tasks[t].counts);
+		free(frontier->tasks[t].tilecounts);
+	}
+	free(frontier->tasks);
+	free(frontier->schedule);
+	free(frontier->index);
+	free(frontier->order);
+	free(frontier->links);
+	free(frontier->linkcount);
+	free(frontier->constraints);
+	free(frontier->components);
+}
+
+int
+odds_compute(struct odds *odds)
+{
+	/*
+	 * probabilities for the board as the solver last saw it, the solver
+	 * should be synced and run first. returns 0 if memory runs out or the
+	 * numbers cannot all be met
+	 */
+	const struct board *board = odds->solver->board;
+	struct frontier frontier;
+	pthread_t pool[ODDS_MAXTHREADS];
+	int threads = 0, ok = 0;
+	int *id = malloc(board->bits * sizeof(int));
+	memset(&frontier, 0, sizeof frontier);
+	frontier.board = board;
+	pthread_mutex_init(&frontier.lock, NULL);
+	odds->frontier = odds->interior = odds->approximate = 0;
+	odds->components = 0;
+	if (!id)
+		goto done;
+	for (size_t i = 0; i < board->bits; i++)
+		id[i] = -1;
+	if (!buildfrontier(odds, &frontier, id) || !orderfrontier(&frontier) || !maketasks(&frontier))
+		goto done;
+	odds->components = frontier.componentcount;
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t i = board_index(board, x, y);
+			if (BOARD_TEST(board->hidden, i) && !BOARD_TEST(odds->solver->safe, i) &&
+					!BOARD_TEST(odds->solver->mine, i) && id[i] < 0)
+				odds->interior++;
+		}
+	}
+
+	/* the calling thread works too, extra threads only help with several tasks */
+	int extra = odds->threads - 1;
+	if (extra > frontier.taskcount - 1)
+		extra = frontier.taskcount - 1;
+	for (; threads < extra; threads++)
+	{
+		if (pthread_create(&pool[threads], NULL, worker, &frontier) != 0)
+			break;
+	}
+	worker(&frontier);
+	for (int t = 0; t < threads; t++)
+		pthread_join(pool[t], NULL);
+	if (!frontier.failed)
+		ok = combine(odds, &frontier, id);
+done:
+	pthread_mutex_destroy(&frontier.lock);
+	freefrontier(&frontier);
+	free(id);
+	return ok;
+}
+
+int
+odds_best(const struct odds *odds, int *x, int *y)
+{
+	/* the hidden tile least likely to be a mine, the first one on a tie */
+	const struct board *board = odds->solver->board;
+	double best = 2;
+	for (int ty = 0; ty < board->height; ty++)
+	{
+		for (int tx = 0; tx < board->width; tx++)
+		{
+			size_t i = board_index(board, tx, ty);
+			if (BOARD_TEST(board->hidden, i) && odds->probability[i] < best)
+			{
+				best = odds->probability[i];
+				*x = tx;
+				*y = ty;
+			}
+		}
+	}
+	return best < 2;
+}
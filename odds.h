@@ -0,0 +1,67 @@
+/*
+ * minesweeper mine probabilities (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ODDS_H
+#define ODDS_H
+
+#include <stddef.h>
+#include "board.h"
+#include "solver.h"
+
+#define ODDS_MAXTHREADS 64
+#define ODDS_SPLIT 16	/* components this big are searched as several tasks */
+#define ODDS_SPLITBITS 4
+#define ODDS_MAXNODES (1L << 21)	/* search steps a component gets before it is approximated */
+
+/*
+ * the chance that each hidden tile is a mine, given the revealed numbers,
+ * the solver's deductions and how many mines the board has in total.
+ *
+ * the frontier, the unsettled hidden tiles next to a revealed number, is
+ * split into components that share no numbers. every arrangement of mines
+ * in a component that fits its numbers is counted by a backtracking search,
+ * components are searched in parallel and large ones are split further by
+ * fixing their first tiles. the per component counts are then combined
+ * with the number of ways the remaining mines fit in the tiles off the
+ * frontier, that binomial is worked out in log space since it overflows a
+ * double on any large board.
+ *
+ * a component whose search takes more than ODDS_MAXNODES steps, shared
+ * between its tasks, is given up on and its tiles are counted as interior
+ * tiles instead. approximate says how many tiles that happened to, their
+ * odds and the interior's are then an estimate rather than exact.
+ *
+ * probability is indexed like the board's planes and is only meaningful
+ * for hidden tiles
+ */
+struct odds
+{
+	const struct solver *solver;
+	int threads;
+	double *probability;
+	size_t frontier;	/* unsettled tiles next to a number */
+	size_t interior;	/* unsettled tiles nowhere near one */
+	int components;
+	size_t approximate;	/* frontier tiles given the interior's odds */
+};
+
+int odds_init(struct odds *odds, const struct solver *solver, int threads);
+void odds_free(struct odds *odds);
+int odds_compute(struct odds *odds);
+int odds_best(const struct odds *odds, int *x, int *y);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * seeded random number generators (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "rng.h"
+
+static const char *names[RNG_COUNT] = { "xoshiro", "pcg" };
+
+static uint64_t splitmix64(uint64_t *state);
+static uint64_t rotl(uint64_t x, int k);
+static uint32_t pcg32(struct rng *rng);
+
+static uint64_t
+splitmix64(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static uint64_t
+rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static uint32_t
+pcg32(struct rng *rng)
+{
+	uint64_t old = rng->s[0];
+	rng->s[0] = old * 6364136223846793005ULL + rng->s[1];
+	uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+	uint32_t rot = old >> 59;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void
+rng_seed(struct rng *rng, enum RNG_TYPE type, uint64_t seed)
+{
+	/* expand the user seed with splitmix so small seeds still give full state */
+	rng->type = type;
+	for (int i = 0; i < 4; i++)
+		rng->s[i] = splitmix64(&seed);
+	if (type == RNG_PCG)
+		rng->s[1] |= 1; /* the pcg increment must be odd */
+}
+
+uint64_t
+rng_next(struct rng *rng)
+{
+	if (rng->type == RNG_PCG)
+	{
+		uint64_t hi = pcg32(rng);
+		return (hi << 32) | pcg32(rng);
+	}
+
+	uint64_t *s = rng->s;
+	uint64_t result = rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return result;
+}
+
+uint64_t
+rng_below(struct rng *rng, uint64_t bound)
+{
+	/* reject the short top range so every value in [0, bound) is equally likely */
+	uint64_t threshold = -bound % bound;
+	for (;;)
+	{
+		uint64_t r = rng_next(rng);
+		if (r >= threshold)
+			return r % bound;
+	}
+}
+
+uint64_t
+rng_hash(uint64_t key, uint64_t counter)
+{
+	/* counter based, the same key and counter always give the same value */
+	uint64_t state = splitmix64(&key) ^ counter;
+	return splitmix64(&state);
+}
+
+int
+rng_parse(const char *name, enum RNG_TYPE *type)
+{
+	/* the generator called name, as taken by -rng. returns 0 for an unknown one */
+	for (int t = 0; t < RNG_COUNT; t++)
+	{
+		if (strcmp(name, names[t]) == 0)
+		{
+			*type = t;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const char *
+rng_name(enum RNG_TYPE type)
+{
+	return (unsigned)type < RNG_COUNT ? names[type] : "unknown";
+}
@@ -0,0 +1,43 @@
+/*
+ * seeded random number generators (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+enum RNG_TYPE
+{
+	RNG_XOSHIRO = 0, /* xoshiro256** */
+	RNG_PCG,	 /* pcg32, two outputs per 64 bit draw */
+	RNG_COUNT,
+};
+
+struct rng
+{
+	enum RNG_TYPE type;
+	uint64_t s[4];
+};
+
+void rng_seed(struct rng *rng, enum RNG_TYPE type, uint64_t seed);
+uint64_t rng_next(struct rng *rng);
+uint64_t rng_below(struct rng *rng, uint64_t bound);
+uint64_t rng_hash(uint64_t key, uint64_t counter);
+int rng_parse(const char *name, enum RNG_TYPE *type);
+const char *rng_name(enum RNG_TYPE type);
+
+#endif
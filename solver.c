@@ -0,0 +1,321 @@
+/*
+ * minesweeper deduction (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "solver.h"
+
+/*
+ * two numbers are compared in a 7x7 window of tiles centred on the first,
+ * which holds the neighbors of any number up to two tiles away
+ */
+#define WINDOW 7
+#define WINDOW_BIT(dx, dy) ((uint64_t)1 << (((dx) + 3) + ((dy) + 3) * WINDOW))
+
+static int queuetile(struct solver *solver, size_t i);
+static int queuearound(struct solver *solver, size_t i);
+static int restart(struct solver *solver);
+static uint64_t unknowns(const struct solver *solver, size_t i, int dx, int dy, int *need);
+static size_t settle(struct solver *solver, size_t centre, uint64_t tiles, int mines);
+static size_t examine(struct solver *solver, size_t i);
+
+static int
+queuetile(struct solver *solver, size_t i)
+{
+	/* sentinels are never queued, their counts mean nothing */
+	int x, y;
+	board_coords(solver->board, i, &x, &y);
+	if (!board_contains(solver->board, x, y) || BOARD_TEST(solver->queued, i))
+		return 1;
+	if (solver->workcount == solver->workcap)
+	{
+		size_t cap = solver->workcap ? solver->workcap * 2 : 64;
+		size_t *work = realloc(solver->work, cap * sizeof(size_t));
+		if (!work)
+			return 0;
+		solver->work = work;
+		solver->workcap = cap;
+	}
+	BOARD_SET(solver->queued, i);
+	solver->work[solver->workcount++] = i;
+	return 1;
+}
+
+static int
+queuearound(struct solver *solver, size_t i)
+{
+	size_t neighbors[8];
+	board_neighbors(solver->board, i, neighbors);
+	for (int n = 0; n < 8; n++)
+	{
+		if (!queuetile(solver, neighbors[n]))
+			return 0;
+	}
+	return 1;
+}
+
+static int
+restart(struct solver *solver)
+{
+	/* forget every deduction and look at every revealed number again */
+	const struct board *board = solver->board;
+	size_t bytes = board->words * sizeof(uint64_t);
+	memset(solver->safe, 0, bytes);
+	memset(solver->mine, 0, bytes);
+	memset(solver->queued, 0, bytes);
+	memcpy(solver->hidden, board->hidden, bytes);
+	solver->safecount = 0;
+	solver->minecount = 0;
+	solver->workcount = 0;
+	for (int y = 0; y < board->height; y++)
+	{
+		for (int x = 0; x < board->width; x++)
+		{
+			size_t i = board_index(board, x, y);
+			if (!BOARD_TEST(board->hidden, i) && !queuetile(solver, i))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+int
+solver_init(struct solver *solver, const struct board *board)
+{
+	memset(solver, 0, sizeof *solver);
+	solver->board = board;
+	solver->safe = calloc(board->words, sizeof(uint64_t));
+	solver->mine = calloc(board->words, sizeof(uint64_t));
+	solver->hidden = calloc(board->words, sizeof(uint64_t));
+	solver->queued = calloc(board->words, sizeof(uint64_t));
+	if (!solver->safe || !solver->mine || !solver->hidden || !solver->queued || !restart(solver))
+	{
+		solver_free(solver);
+		return 0;
+	}
+	return 1;
+}
+
+void
+solver_free(struct solver *solver)
+{
+	free(solver->safe);
+	free(solver->mine);
+	free(solver->hidden);
+	free(solver->queued);
+	free(solver->work);
+	memset(solver, 0, sizeof *solver);
+}
+
+int
+solver_sync(struct solver *solver)
+{
+	/*
+	 * catch up with tiles opened since the last sync, a word at a time.
+	 * their numbers and the numbers around them are queued. a tile hidden
+	 * again means the board went back, so everything is redone
+	 */
+	const struct board *board = solver->board;
+	for (size_t w = 0; w < board->words; w++)
+	{
+		if (board->hidden[w] & ~solver->hidden[w])
+			return restart(solver);
+	}
+	for (size_t w = 0; w < board->words; w++)
+	{
+		uint64_t shown = solver->hidden[w] & ~board->hidden[w];
+		for (; shown; shown &= shown - 1)
+		{
+			size_t i = (w << 6) + board_ctz64(shown);
+			if (BOARD_TEST(solver->safe, i))
+			{
+				BOARD_CLEAR(solver->safe, i);
+				solver->safecount--;
+			}
+			if (BOARD_TEST(solver->mine, i))
+			{
+				BOARD_CLEAR(solver->mine, i);
+				solver->minecount--;
+			}
+			if (!queuetile(solver, i) || !queuearound(solver, i))
+				return 0;
+		}
+		solver->hidden[w] = board->hidden[w];
+	}
+	return 1;
+}
+
+static uint64_t
+unknowns(const struct solver *solver, size_t i, int dx, int dy, int *need)
+{
+	/*
+	 * the unsettled hidden neighbors of the number at i, placed in the
+	 * window as if i were dx, dy from the centre. need is how many of them
+	 * are mines
+	 */
+	const struct board *board = solver->board;
+	size_t neighbors[8];
+	const int nx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+	const int ny[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+	uint64_t tiles = 0;
+	*need = board_countat(board, i);
+	board_neighbors(board, i, neighbors);
+	for (int n = 0; n < 8; n++)
+	{
+		size_t t = neighbors[n];
+		if (BOARD_TEST(solver->mine, t))
+			(*need)--;
+		else if (BOARD_TEST(board->hidden, t) && !BOARD_TEST(solver->safe, t))
+			tiles |= WINDOW_BIT(dx + nx[n], dy + ny[n]);
+	}
+	return tiles;
+}
+
+static size_t
+settle(struct solver *solver, size_t centre, uint64_t tiles, int mines)
+{
+	/* mark every window tile as a mine or safe and queue the numbers around it */
+	const struct board *board = solver->board;
+	size_t count = 0;
+	for (; tiles; tiles &= tiles - 1)
+	{
+		int bit = board_ctz64(tiles);
+		size_t i = centre + (ptrdiff_t)(bit / WINDOW - 3) * board->stride + (bit % WINDOW - 3);
+		if (BOARD_TEST(solver->safe, i) || BOARD_TEST(solver->mine, i))
+			continue;
+#ifdef BOARD_DEBUG
+		/* deductions never look at the mines, but they have to agree with them */
+		assert(BOARD_TEST(board->mine, i) == (uint64_t)!!mines);
+#endif
+		if (mines)
+		{
+			BOARD_SET(solver->mine, i);
+			solver->minecount++;
+		}
+		else
+		{
+			BOARD_SET(solver->safe, i);
+			solver->safecount++;
+		}
+		queuearound(solver, i);
+		count++;
+	}
+	return count;
+}
+
+static size_t
+examine(struct solver *solver, size_t i)
+{
+	/*
+	 * single number rules first, then every number up to two tiles away.
+	 * if b has d more mines to place than a, then the tiles only b touches
+	 * hold at least d of them, so d equal to their count makes them all
+	 * mines and the tiles only a touches all safe
+	 */
+	const struct board *board = solver->board;
+	int x, y, needa, needb;
+	if (BOARD_TEST(board->hidden, i) || BOARD_TEST(board->mine, i))
+		return 0;
+	uint64_t a = unknowns(solver, i, 0, 0, &needa);
+	if (!a)
+		return 0;
+	if (needa == 0)
+		return settle(solver, i, a, 0);
+	if (needa == board_popcount64(a))
+		return settle(solver, i, a, 1);
+	board_coords(board, i, &x, &y);
+	for (int dy = -2; dy <= 2; dy++)
+	{
+		for (int dx = -2; dx <= 2; dx++)
+		{
+			if ((!dx && !dy) || !board_contains(board, x + dx, y + dy))
+				continue;
+			size_t j = board_index(board, x + dx, y + dy);
+			if (BOARD_TEST(board->hidden, j) || BOARD_TEST(board->mine, j))
+				continue;
+			uint64_t b = unknowns(solver, j, dx, dy, &needb);
+			/* numbers sharing no tiles say nothing the single rules miss */
+			if (!(a & b))
+				continue;
+			uint64_t onlya = a & ~b, onlyb = b & ~a;
+			size_t count = 0;
+			if (needb - needa == board_popcount64(onlyb))
+				count = settle(solver, i, onlyb, 1) + settle(solver, i, onlya, 0);
+			else if (needa - needb == board_popcount64(onlya))
+				count = settle(solver, i, onlya, 1) + settle(solver, i, onlyb, 0);
+			/* a is out of date once anything settles, it is queued again */
+			if (count)
+				return count;
+		}
+	}
+	return 0;
+}
+
+size_t
+solver_run(struct solver *solver)
+{
+	/* work through the queue until nothing more follows, returns the new deductions */
+	size_t count = 0;
+	while (solver->workcount)
+	{
+		size_t i = solver->work[--solver->workcount];
+		BOARD_CLEAR(solver->queued, i);
+		count += examine(solver, i);
+	}
+	return count;
+}
+
+int
+solver_nextsafe(const struct solver *solver, int *x, int *y)
+{
+	/* the first safe tile in row-major order, 0 if there is none */
+	for (size_t w = 0; w < solver->board->words; w++)
+	{
+		if (solver->safe[w])
+		{
+			board_coords(solver->board, (w << 6) + board_ctz64(solver->safe[w]), x, y);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+size_t
+solver_opensafe(struct solver *solver, struct board *board)
+{
+	/*
+	 * reveals every tile found safe so far on board, which must be the
+	 * solver's own, and returns how many tiles that opened. some are
+	 * opened on the way by an earlier one's flood fill
+	 */
+	size_t total = 0, opened;
+	int x, y;
+	for (size_t w = 0; w < board->words; w++)
+	{
+		for (uint64_t safe = solver->safe[w]; safe; safe &= safe - 1)
+		{
+			size_t i = (w << 6) + board_ctz64(safe);
+			if (!BOARD_TEST(board->hidden, i))
+				continue;
+			board_coords(board, i, &x, &y);
+			board_reveal(board, x, y, &opened);
+			total += opened;
+		}
+	}
+	return total;
+}
@@ -0,0 +1,71 @@
+/*
+ * minesweeper deduction (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+
+/*
+ * works out what a player could from the revealed numbers alone, the mines
+ * of hidden tiles are never looked at and neither are the player's flags,
+ * which can be wrong. each revealed number says how many of its hidden
+ * neighbors are mines. a number whose hidden neighbors are all mines or all
+ * safe settles them, and two numbers up to two tiles apart settle the tiles
+ * only one of them touches when the difference in their counts leaves no
+ * choice. deductions are kept in safe and mine planes indexed like the
+ * board's, both only ever hold hidden tiles.
+ *
+ * numbers are re-examined from a worklist, so after a reveal only the
+ * numbers next to newly opened or newly settled tiles are looked at again
+ */
+struct solver
+{
+	const struct board *board;
+	uint64_t *safe;
+	uint64_t *mine;
+	size_t safecount;
+	size_t minecount;
+	uint64_t *hidden;	/* the board's hidden plane as of the last sync */
+	uint64_t *queued;	/* tiles on the worklist */
+	size_t *work;
+	size_t workcount;
+	size_t workcap;
+};
+
+int solver_init(struct solver *solver, const struct board *board);
+void solver_free(struct solver *solver);
+int solver_sync(struct solver *solver);
+size_t solver_run(struct solver *solver);
+int solver_nextsafe(const struct solver *solver, int *x, int *y);
+size_t solver_opensafe(struct solver *solver, struct board *board);
+
+static inline int
+solver_issafe(const struct solver *solver, int x, int y)
+{
+	return BOARD_TEST(solver->safe, board_index(solver->board, x, y));
+}
+
+static inline int
+solver_ismine(const struct solver *solver, int x, int y)
+{
+	return BOARD_TEST(solver->mine, board_index(solver->board, x, y));
+}
+
+#endif
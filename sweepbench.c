@@ -0,0 +1,258 @@
+/*
+ * plays random minesweeper boards as fast as possible (Daniel Jones daniel@danieljon.es)
+ *
+ * this program is free software: you can redistribute it and/or modify
+ * it under the terms of the gnu general public license as published by
+ * the free software foundation, either version 3 of the license, or
+ * (at your option) any later version.
+ *
+ * this program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * merchantability or fitness for a particular purpose.  see the
+ * gnu general public license for more details.
+ *
+ * you should have received a copy of the gnu general public license
+ * along with this program.  if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "board.h"
+#include "solver.h"
+#include "odds.h"
+
+#define MAXTHREADS 256
+#define CHUNK 256	/* games a worker takes at a time */
+
+/* totals for a worker, added to the batch's when it finishes */
+struct tally
+{
+	long long games;
+	long long wins;
+	long long revealed;
+	long long guesses;
+	long long approximate;	/* guesses made on estimated odds */
+	long long failed;
+};
+
+/* shared between workers, only next and total change once they start */
+struct batch
+{
+	int width;
+	int height;
+	int minecount;
+	unsigned long long seed;
+	long long games;
+	int useodds;
+	int regions;
+	enum RNG_TYPE rng;
+	long long next;
+	struct tally total;
+	pthread_mutex_t lock;
+} batch = { .width = 30, .height = 16, .minecount = 99, .games = 1000000, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+int guess(struct board *board, struct solver *solver, struct rng *rng, struct tally *tally, int *x, int *y);
+int playgame(long long game, struct tally *tally);
+void *worker(void *arg);
+
+int
+guess(struct board *board, struct solver *solver, struct rng *rng, struct tally *tally, int *x, int *y)
+{
+	/*
+	 * the least likely tile with -odds, otherwise any hidden tile the
+	 * solver has not marked as a mine. there is always one until the game
+	 * is won
+	 */
+	if (batch.useodds)
+	{
+		struct odds odds;
+		int ok = odds_init(&odds, solver, 1) && odds_compute(&odds) && odds_best(&odds, x, y);
+		tally->approximate += ok && odds.approximate;
+		odds_free(&odds);
+		if (ok)
+			return 1;
+	}
+	for (;;)
+	{
+		size_t t = rng_below(rng, board->tiles);
+		*x = t % board->width;
+		*y = t / board->width;
+		if ((board_state(board, *x, *y) & HIDDEN) && !solver_ismine(solver, *x, *y))
+			return 1;
+	}
+}
+
+int
+playgame(long long game, struct tally *tally)
+{
+	/*
+	 * a board as generateboard() makes one, from its own rng stream so a
+	 * game plays the same whichever thread gets it. the first click is in
+	 * the middle, then every tile the solver finds safe and a guess
+	 * whenever it runs dry
+	 */
+	struct board board;
+	struct solver solver;
+	struct rng rng;
+	size_t opened;
+	int x = batch.width / 2, y = batch.height / 2;
+	rng_seed(&rng, batch.rng, rng_hash(batch.seed, game));
+	if (!board_init(&board, batch.width, batch.height))
+		return 0;
+	board_placemines(&board, batch.minecount, &rng);
+	board_countneighbors(&board);
+	if (batch.regions && !board.preset)
+		board_labelregions(&board);
+	int dead = board_reveal(&board, x, y, &opened);
+	if (!solver_init(&solver, &board))
+	{
+		board_free(&board);
+		return 0;
+	}
+	while (!dead && !board_checkwin(&board))
+	{
+		solver_sync(&solver);
+		solver_run(&solver);
+		if (!solver.safecount)
+		{
+			guess(&board, &solver, &rng, tally, &x, &y);
+			tally->guesses++;
+			dead = board_reveal(&board, x, y, &opened);
+			continue;
+		}
+		/* every safe tile before the solver looks again */
+		solver_opensafe(&solver, &board);
+	}
+	tally->games++;
+	tally->wins += !dead;
+	tally->revealed += board.revealed;
+	solver_free(&solver);
+	board_free(&board);
+	return 1;
+}
+
+void *
+worker(void *arg)
+{
+	struct tally tally = {0};
+	(void)arg;
+	for (;;)
+	{
+		pthread_mutex_lock(&batch.lock);
+		long long first = batch.next;
+		batch.next += CHUNK;
+		pthread_mutex_unlock(&batch.lock);
+		if (first >= batch.games)
+			break;
+		for (long long game = first; game < first + CHUNK && game < batch.games; game++)
+		{
+			if (!playgame(game, &tally))
+				tally.failed++;
+		}
+	}
+	pthread_mutex_lock(&batch.lock);
+	batch.total.games += tally.games;
+	batch.total.wins += tally.wins;
+	batch.total.revealed += tally.revealed;
+	batch.total.guesses += tally.guesses;
+	batch.total.approximate += tally.approximate;
+	batch.total.failed += tally.failed;
+	pthread_mutex_unlock(&batch.lock);
+	return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	batch.seed = time(NULL);
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (strcmp(argv[arg], "-odds") == 0)
+		{
+			batch.useodds = 1;
+			continue;
+		}
+		if (strcmp(argv[arg], "-regions") == 0)
+		{
+			batch.regions = 1;
+			continue;
+		}
+		if (arg+1 >= argc)
+		{
+			threads = 0;
+			break;
+		}
+		if (strcmp(argv[arg], "-j") == 0)
+			threads = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-games") == 0)
+			batch.games = atoll(argv[++arg]);
+		else if (strcmp(argv[arg], "-width") == 0)
+			batch.width = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-height") == 0)
+			batch.height = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-mines") == 0)
+			batch.minecount = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-seed") == 0)
+			batch.seed = strtoull(argv[++arg], NULL, 0);
+		else if (strcmp(argv[arg], "-rng") == 0 && rng_parse(argv[arg+1], &batch.rng))
+			arg++;
+		else
+		{
+			threads = 0;
+			break;
+		}
+	}
+	if (threads < 1 || batch.games < 1 || batch.width <= 0 || batch.height <= 0 || batch.minecount <= 0 ||
+			(long long)batch.minecount >= (long long)batch.width * batch.height)
+	{
+		printf("usage: %s [-j threads] [-games n] [-width w] [-height h] [-mines n] [-seed n] [-rng xoshiro|pcg] [-odds] [-regions]\n", argv[0]);
+		return 1;
+	}
+	if (threads > MAXTHREADS)
+		threads = MAXTHREADS;
+
+	struct timespec begin, end;
+	pthread_t pool[MAXTHREADS];
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (long t = 0; t < threads; t++)
+	{
+		if (pthread_create(&pool[t], NULL, worker, NULL) != 0)
+		{
+			/* run with however many workers did start */
+			threads = t;
+			break;
+		}
+	}
+	if (threads == 0)
+		worker(NULL);
+	for (long t = 0; t < threads; t++)
+		pthread_join(pool[t], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+	if (seconds <= 0)
+		seconds = 1e-9;
+	/* wilson score interval, it stays sensible for win rates near 0 or 1 */
+	double n = batch.total.games ? batch.total.games : 1, z = 1.96;
+	double p = batch.total.wins / n;
+	double centre = (p + z*z / (2*n)) / (1 + z*z / n);
+	double spread = z * sqrt(p * (1 - p) / n + z*z / (4*n*n)) / (1 + z*z / n);
+	printf("%lld games of %dx%d with %d mines, seed %llu (%s), on %ld threads in %.3fs\n",
+			batch.total.games, batch.width, batch.height, batch.minecount, batch.seed, rng_name(batch.rng),
+			threads ? threads : 1, seconds);
+	printf("%.0f games/s, %.0f tiles revealed/s, %.2f guesses a game\n",
+			batch.total.games / seconds, batch.total.revealed / seconds, batch.total.guesses / n);
+	printf("won %.3f%%, 95%% interval %.3f%% to %.3f%%\n",
+			p * 100, (centre - spread) * 100, (centre + spread) * 100);
+	if (batch.total.approximate)
+		printf("%lld guesses were made on approximate odds\n", batch.total.approximate);
+	if (batch.total.failed)
+		printf("%lld games could not be played\n", batch.total.failed);
+	return batch.total.failed != 0;
+}